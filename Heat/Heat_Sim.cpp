@@ -1,6 +1,10 @@
-﻿#include "../programs.h"
+﻿#include "checkpoint.h"
+#include "frames.h"
+#include "heat.h"
+#include "stencil.h"
 
 #include <mpi.h>
+#include <memory>
 #include <vector>
 #include <fstream>
 
@@ -13,39 +17,20 @@ constexpr int COLUMNS = 50;
 constexpr int STEP_INTERVAL = 5; // ms
 constexpr int NUM_STEPS = 1000; // total time = STEPS_INTERVAL * NUM_STEPS milliseconds
 
-constexpr double MAX_TEMP = 1000.0;
-
-constexpr double grid_distance = 0.001; // 0.001 meters = 1 mm
-constexpr double thermal_diffusivity = 23e-6; // alpha for iron is 2.3 × 10^(-5) m^2/s
-
 constexpr int OPENGL_PREVIEW_FRAME_DELAY = 5; // minimum milliseconds between frames
 
-enum class BoundaryCondition {
-	// this was an interesting rabbit hole.
-	Neumann,	// no heat loss to boundary
-	Dirichlet,	// boundary is absolute zero❅
-	//Convective,	// boundary is air~~ 
-	// (not implemented because i've had enough of thermodynamics for one day)
-	// (actually, enough for a lifetime)
-};
+const std::string FRAMES_FILE = "heat_sim_results.frames";
+const std::string TEXT_FILE = "heat_sim_results.txt";
+const std::string CHECKPOINT_FILE = "heat_sim.checkpoint";
 
-double boundary_adjusted_temp(double self_temp, BoundaryCondition condition = BoundaryCondition::Neumann);
-void preview_in_txt(const std::vector<std::vector<uint8_t>>& results, int columns);
+int convert_to_txt(const std::string& frames_path, const std::string& text_path);
 
 // THIS IS DISABLED IF USE_OPENGL_FOR_PREVIEW IS NOT DEFINED!!!!!!!!!!!!!!!!
 // If you want OpenGL based output, define USE_OPENGL_FOR_PREVIEW in the project settings.
 // Properties -> C/C++ -> Preprocessor -> Preprocessor Definitions -> Add USE_OPENGL_FOR_PREVIEW to the end of the list.
-void preview_in_gl(const std::vector<std::vector<uint8_t>>& results, int rows, int columns);
+int preview_in_gl(const std::string& frames_path);
 
-void record_interval(vector<double>& grid, vector<vector<uint8_t>>& results, int rows, int columns) {
-	results.push_back(vector<uint8_t>(rows * columns));
-
-	for (int i = 0; i < rows; i++) {
-		for (int j = 0; j < columns; j++) {
-			results.back()[i * columns + j] = grid[i * columns + j] / MAX_TEMP * 255;
-		}
-	}
-}
+int run_scatter_gather(const HeatProblem& problem, Stencil::Kernel kernel, int output_interval, FrameWriter* frames);
 
 int heat_sim(Arguments args) {
 	int rank;
@@ -60,6 +45,19 @@ int heat_sim(Arguments args) {
 	}
 #endif // USE_OPENGL_FOR_PREVIEW
 
+	// turning a frame stream from an earlier run into something to look at doesn't need the other processes
+	if (args.has_option("convert")) {
+		return (rank == 0) ? convert_to_txt(args.option("convert"), args.option("txt", TEXT_FILE)) : 0;
+	}
+	if (args.has_option("preview")) {
+#ifdef USE_OPENGL_FOR_PREVIEW
+		return (rank == 0) ? preview_in_gl(args.option("preview")) : 0;
+#else
+		if (rank == 0) std::cerr << "Error: --preview needs USE_OPENGL_FOR_PREVIEW, see the README.\n";
+		return 1;
+#endif
+	}
+
 	int no_of_rows = ROWS;
 	int no_of_columns = COLUMNS;
 	int step_interval = STEP_INTERVAL;
@@ -78,6 +76,109 @@ int heat_sim(Arguments args) {
 		num_steps = std::stoi(args.get(3));
 	}
 
+	// a restarted run carries on with the grid of its checkpoint, the number of steps is still the total
+	std::string restart_path = args.option("restart");
+	CheckpointHeader restart;
+	if (!restart_path.empty()) {
+		if (!read_checkpoint_header(restart_path, restart, MPI_COMM_WORLD)) return 1;
+		no_of_rows = (int)restart.rows;
+		no_of_columns = (int)restart.columns;
+		step_interval = (int)restart.step_interval;
+	}
+
+	HeatProblem problem{ no_of_rows, no_of_columns, step_interval, num_steps };
+	if (!restart_path.empty()) problem.boundary = (BoundaryCondition)restart.boundary;
+
+	// a frame every this many steps, streamed to a file on rank 0 as the simulation goes
+	int output_interval = (int)args.option_int("output-interval", 1);
+	std::string frames_path = args.option("frames", FRAMES_FILE);
+	std::unique_ptr<FrameWriter> frames;
+	if (rank == 0 && output_interval > 0) frames = std::make_unique<FrameWriter>(frames_path, no_of_rows, no_of_columns, output_interval);
+
+	// options that only exist for resident slabs switch them on
+	bool resident = args.has_option("resident") || args.has_option("halo") || args.has_option("decomposition") || args.has_option("process-grid") || args.has_option("time-block")
+		|| args.has_option("checkpoint-interval") || args.has_option("restart") || args.has_option("implicit") || args.has_option("until-steady");
+
+	bool steady_state = args.has_option("steady-state");
+	if (rank == 0 && !steady_state && !args.has_option("implicit") && step_interval > HeatProblem::stable_step_interval()) {
+		std::cout << "Warning: steps longer than " << HeatProblem::stable_step_interval() << " ms aren't stable, try --implicit." << std::endl;
+	}
+
+	if (steady_state) {
+		ResidentOptions options;
+		options.output_interval = output_interval;
+		options.solver_tolerance = args.option_double("solver-tolerance", options.solver_tolerance);
+		options.max_iterations = (int)args.option_int("max-iterations", 100);
+
+		int rc = run_steady_state(problem, options, frames.get());
+		if (rc != 0) return rc;
+	}
+	else if (resident) {
+		ResidentOptions options;
+		options.output_interval = output_interval;
+		options.persistent_halo = args.option("halo") == "persistent";
+		if (args.option("decomposition") == "blocks" || args.has_option("process-grid")) options.decomposition = Decomposition::Blocks;
+		std::string process_grid = args.option("process-grid");
+		size_t by = process_grid.find('x');
+		if (by != std::string::npos) {
+			options.process_rows = std::stoi(process_grid.substr(0, by));
+			options.process_columns = std::stoi(process_grid.substr(by + 1));
+		}
+
+		std::string time_block = args.option("time-block", "1");
+		options.time_block = (time_block == "auto") ? 0 : std::stoi(time_block);
+		options.checkpoint_interval = (int)args.option_int("checkpoint-interval", 0);
+		options.checkpoint_path = args.option("checkpoint", CHECKPOINT_FILE);
+		options.restart_path = restart_path;
+		if (args.has_option("implicit")) options.integrator = (args.option("implicit") == "euler") ? Integrator::BackwardEuler : Integrator::CrankNicolson;
+		options.solver_tolerance = args.option_double("solver-tolerance", options.solver_tolerance);
+		options.max_iterations = (int)args.option_int("max-iterations", options.max_iterations);
+		if (args.has_option("until-steady")) options.steady_tolerance = args.option_double("until-steady", 1e-6);
+		options.check_interval = (int)args.option_int("check-interval", options.check_interval);
+
+		int rc = run_resident(problem, options, frames.get());
+		if (rc != 0) return rc;
+	}
+	else {
+		std::string kernel_name = args.option("kernel", "simd");
+		Stencil::Kernel kernel;
+		if (!Stencil::kernel_from_name(kernel_name, kernel)) {
+			if (rank == 0) std::cerr << "Error: unknown kernel " << kernel_name << ", it has to be simd or loop.\n";
+			return 1;
+		}
+		int rc = run_scatter_gather(problem, kernel, output_interval, frames.get());
+		if (rc != 0) return rc;
+	}
+
+	if (frames && frames->is_open()) {
+		frames->close();
+		std::cout << "Wrote " << frames->frames() << " frames to " << frames_path << ", " << frames->coded_bytes() << " bytes for " << frames->raw_bytes()
+			<< " bytes of cells. The simulation waited " << frames->wait_time() << " seconds for the writer." << std::endl;
+#ifdef USE_OPENGL_FOR_PREVIEW
+		return preview_in_gl(frames_path);
+#else
+		std::cout << "heat_sim --convert=" << frames_path << " writes them out as text." << std::endl;
+#endif
+	}
+
+	return 0;
+}
+
+/**
+* The original version: rank 0 holds the grid, scatters it before every step and gathers it back after.
+* With the simd kernel, each rank's rows go into a block with a border of ghost cells instead, see stencil.h.
+*/
+int run_scatter_gather(const HeatProblem& problem, Stencil::Kernel kernel, int output_interval, FrameWriter* frames) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	int world_size;
+	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+	int no_of_rows = problem.rows;
+	int no_of_columns = problem.columns;
+	int step_interval = problem.step_interval;
+	int num_steps = problem.num_steps;
+
 	vector<double> grid;
 
 	if (rank == 0) {
@@ -104,34 +205,60 @@ int heat_sim(Arguments args) {
 	vector<double> upper_neighbor(no_of_columns);
 	vector<double> lower_neighbor(no_of_columns);
 
-	vector<vector<uint8_t>> results;
-	if (rank == 0) record_interval(grid, results, no_of_rows, no_of_columns);
+	// the simd kernel's rows, with a ghost cell on every side. They are scattered straight into it and gathered straight out of it
+	// with a vector type, and the ghost rows are received into its first and last rows.
+	bool simd = kernel == Stencil::Kernel::Simd;
+	int stride = no_of_columns + 2;
+	vector<double> padded;
+	vector<double> padded_output;
+	MPI_Datatype padded_rows;
+	MPI_Type_vector(local_rows, no_of_columns, stride, MPI_DOUBLE, &padded_rows);
+	MPI_Type_commit(&padded_rows);
+	if (simd) {
+		padded.resize((size_t)(local_rows + 2) * stride);
+		padded_output.resize(padded.size());
+	}
+	double* padded_cells = padded.data() + stride + 1;
+	double* padded_output_cells = padded_output.data() + stride + 1;
+	double coefficient = problem.coefficient();
+	double kernel_time = 0;
+
+	if (rank == 0) {
+		std::cout << "Kernel: " << Stencil::kernel_name(kernel);
+		if (simd) std::cout << " (" << Stencil::SIMD_NAME << ")";
+		std::cout << std::endl;
+	}
+
+	if (frames) frames->write(grid.data());
 
 	for (int iteration = 0; iteration < num_steps; iteration++) {
-		if (iteration % (num_steps / 10) == 0) {
+		if (iteration % std::max(1, num_steps / 10) == 0) {
 			if (rank == 0) std::cout << "Approximately " << (double)iteration / num_steps * 100 << "% done." << std::endl;
 		}
-		if (rank == 0) grid[10 * no_of_columns + 10] = 1000;
-		if (rank == 0) grid[40 * no_of_columns + 25] = 1000;
+		if (rank == 0) apply_sources(problem, grid.data(), { 0, no_of_rows }, { 0, no_of_columns }, no_of_columns);
+
+		if (simd) MPI_Scatterv(grid.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, padded_cells, 1, padded_rows, 0, MPI_COMM_WORLD);
+		else MPI_Scatterv(grid.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, local_grid.data(), sendcounts[rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-		MPI_Scatterv(grid.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, local_grid.data(), sendcounts[rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		MPI_Request requests[4] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL };
 
-		MPI_Request requests[4];
+		const double* first_row = simd ? padded_cells : local_grid.data();
+		const double* last_row = simd ? padded_cells + (local_rows - 1) * stride : local_grid.data() + (local_rows - 1) * no_of_columns;
+		double* upper_ghost = simd ? padded_cells - stride : upper_neighbor.data();
+		double* lower_ghost = simd ? padded_cells + local_rows * stride : lower_neighbor.data();
 
 		if (rank > 0) {
-			MPI_Isend(local_grid.data(), no_of_columns, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD, &requests[0]);
-			MPI_Irecv(upper_neighbor.data(), no_of_columns, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD, &requests[1]);
+			MPI_Isend(first_row, no_of_columns, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD, &requests[0]);
+			MPI_Irecv(upper_ghost, no_of_columns, MPI_DOUBLE, rank - 1, 0, MPI_COMM_WORLD, &requests[1]);
 		}
 
 		if (rank < world_size - 1) {
-			MPI_Isend(local_grid.data() + (local_rows - 1) * no_of_columns, no_of_columns, MPI_DOUBLE, rank + 1, 0, MPI_COMM_WORLD, &requests[2]);
-			MPI_Irecv(lower_neighbor.data(), no_of_columns, MPI_DOUBLE, rank + 1, 0, MPI_COMM_WORLD, &requests[3]);
+			MPI_Isend(last_row, no_of_columns, MPI_DOUBLE, rank + 1, 0, MPI_COMM_WORLD, &requests[2]);
+			MPI_Irecv(lower_ghost, no_of_columns, MPI_DOUBLE, rank + 1, 0, MPI_COMM_WORLD, &requests[3]);
 		}
 
-		int request_start = (rank > 0) ? 2 : 0;
-		int request_end = (rank < world_size - 1) ? 2 : 4;
-
-		MPI_Waitall(request_end - request_start, requests + request_start, MPI_STATUSES_IGNORE);
+		// requests that were never posted are MPI_REQUEST_NULL, which Waitall skips
+		MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
 
 		//local_grid.insert(local_grid.begin(), upper_neighbor.begin(), upper_neighbor.end());
 		//local_grid.insert(local_grid.end(), lower_neighbor.begin(), lower_neighbor.end());
@@ -143,74 +270,92 @@ int heat_sim(Arguments args) {
 		bool ghost_row_up = rank > 0;
 		bool ghost_row_down = rank < world_size - 1;
 
-		for (int i = 0; i < local_rows; i++) {
-			for (int j = 0; j < no_of_columns; j++) {
-				double current_temp = local_grid[i * no_of_columns + j];
-				double adjusted = boundary_adjusted_temp(current_temp);
-				// for now, i'm not handling different boundary conditions for different sides
-
-				double left_temp = (j > 0) ? local_grid[i * no_of_columns + j - 1] : adjusted;
-				double right_temp = (j < no_of_columns - 1) ? local_grid[i * no_of_columns + j + 1] : adjusted;
-
-				double up_temp = adjusted;
-				if (i > 0) {
-					up_temp = local_grid[(i - 1) * no_of_columns + j];
-				}
-				else if (ghost_row_up) {
-					up_temp = upper_neighbor[j];
-				}
-
-				double down_temp = adjusted;
-				if (i < local_rows - 1) {
-					down_temp = local_grid[(i + 1) * no_of_columns + j];
-				}
-				else if (ghost_row_down) {
-					down_temp = lower_neighbor[j];
-				}
-
-				bool flag = current_temp == 100;
-
-				double new_temp =
-					current_temp +
-					(
-						(thermal_diffusivity * (step_interval / 1000.0) / (grid_distance * grid_distance))
-						*
-						(left_temp + right_temp + up_temp + down_temp - 4 * current_temp)
-					);
-
-				if (flag) std::cout << new_temp << "=" << thermal_diffusivity * step_interval / (grid_distance * grid_distance) << '*' << (left_temp + right_temp + up_temp + down_temp - 4 * current_temp) << std::endl;
-
-				if (new_temp > MAX_TEMP) {
-					new_temp = MAX_TEMP;
-				}
-				else if (new_temp < 0) {
-					new_temp = 0;
+		Timer kernel_timer;
+		if (simd) {
+			Stencil::fill_boundary(problem.boundary, padded_cells, stride, local_rows, no_of_columns, { !ghost_row_up, !ghost_row_down, true, true }, 0);
+			ThreadPool::instance().parallel_for(0, local_rows, [&](long long first_row, long long last_row) {
+				Stencil::update(padded_cells, padded_output_cells, stride, (int)first_row, (int)last_row, 0, no_of_columns, coefficient);
+			});
+		}
+		// rows are independent, so they are shared out over the thread pool
+		else ThreadPool::instance().parallel_for(0, local_rows, [&](long long first_row, long long last_row) {
+			for (int i = (int)first_row; i < last_row; i++) {
+				for (int j = 0; j < no_of_columns; j++) {
+					double current_temp = local_grid[i * no_of_columns + j];
+					double adjusted = boundary_adjusted_temp(current_temp);
+					// for now, i'm not handling different boundary conditions for different sides
+
+					double left_temp = (j > 0) ? local_grid[i * no_of_columns + j - 1] : adjusted;
+					double right_temp = (j < no_of_columns - 1) ? local_grid[i * no_of_columns + j + 1] : adjusted;
+
+					double up_temp = adjusted;
+					if (i > 0) {
+						up_temp = local_grid[(i - 1) * no_of_columns + j];
+					}
+					else if (ghost_row_up) {
+						up_temp = upper_neighbor[j];
+					}
+
+					double down_temp = adjusted;
+					if (i < local_rows - 1) {
+						down_temp = local_grid[(i + 1) * no_of_columns + j];
+					}
+					else if (ghost_row_down) {
+						down_temp = lower_neighbor[j];
+					}
+
+					double new_temp =
+						current_temp +
+						(
+							(thermal_diffusivity * (step_interval / 1000.0) / (grid_distance * grid_distance))
+							*
+							(left_temp + right_temp + up_temp + down_temp - 4 * current_temp)
+						);
+
+					if (new_temp > MAX_TEMP) {
+						new_temp = MAX_TEMP;
+					}
+					else if (new_temp < 0) {
+						new_temp = 0;
+					}
+
+					//if (iteration == 0) {
+					//	if (new_temp != 0 && new_temp > 500) {
+					//		std::cout << "Iteration " << iteration << ", " << i << ", " << j << ": " << new_temp << std::endl;
+					//	}
+					//}
+
+					local_output[i * no_of_columns + j] = new_temp;
 				}
+			}
+		});
 
-				//if (iteration == 0) {
-				//	if (new_temp != 0 && new_temp > 500) {
-				//		std::cout << "Iteration " << iteration << ", " << i << ", " << j << ": " << new_temp << std::endl;
-				//	}
-				//}
+		kernel_time += kernel_timer.stop().count();
 
-				local_output[i * no_of_columns + j] = new_temp;
-			}
-		}
+		// local_output has no ghost rows, the rows of this rank start right at the beginning
+		if (simd) MPI_Gatherv(padded_output_cells, 1, padded_rows, grid.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		else MPI_Gatherv(local_output.data(), local_rows * no_of_columns, MPI_DOUBLE, grid.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-		MPI_Gatherv(local_output.data() + no_of_columns * (int)ghost_row_up, local_rows * no_of_columns, MPI_DOUBLE, grid.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		if (rank == 0) apply_sources(problem, grid.data(), { 0, no_of_rows }, { 0, no_of_columns }, no_of_columns);
 
-		if (rank == 0) grid[10 * no_of_columns + 10] = 1000;
-		if (rank == 0) grid[40 * no_of_columns + 25] = 1000;
+		if (frames && (iteration + 1) % output_interval == 0) frames->write(grid.data());
+	}
 
-		if (rank == 0) record_interval(grid, results, no_of_rows, no_of_columns);
+	if (rank == 0) {
+		double checksum = 0;
+		for (double value : grid) checksum += value;
+		uint64_t fingerprint = field_fingerprint(grid.data(), { 0, no_of_rows }, { 0, no_of_columns }, no_of_columns, no_of_columns);
+		std::cout << "Field checksum: " << std::setprecision(15) << checksum << std::setprecision(6) << ", fingerprint " << std::hex << fingerprint << std::dec << std::endl;
 	}
 
-#ifdef USE_OPENGL_FOR_PREVIEW
-	if (rank == 0) preview_in_gl(results, no_of_rows, no_of_columns);
-#else
-	if (rank == 0) preview_in_txt(results, no_of_columns);
-#endif
+	double slowest_kernel_time;
+	MPI_Reduce(&kernel_time, &slowest_kernel_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+	if (rank == 0) {
+		double updates = (double)no_of_rows * no_of_columns * num_steps;
+		std::cout << "Kernel took " << slowest_kernel_time << " seconds on the slowest process, " << updates / slowest_kernel_time / 1e6 << " million cell updates per second." << std::endl;
+	}
 
+	MPI_Type_free(&padded_rows);
 	return 0;
 }
 
@@ -227,18 +372,26 @@ double boundary_adjusted_temp(double self_temp, BoundaryCondition condition) {
 	}
 }
 
-void preview_in_txt(const std::vector<std::vector<uint8_t>>& results, int columns) {
-	std::string filename = "heat_sim_results.txt";
-	std::ofstream file(filename);
+/**
+* Writes out every frame of a stream as text, a cell per four characters. This used to be how heat_sim saved its results.
+*/
+int convert_to_txt(const std::string& frames_path, const std::string& text_path) {
+	FrameReader reader(frames_path);
+	if (!reader.is_open()) return 1;
+	int columns = (int)reader.header().columns;
+
+	std::ofstream file(text_path);
 	if (!file) {
 		std::cerr << "Error opening file for writing.\n";
-		return;
+		return 1;
 	}
 
-	for (size_t i = 0; i < results.size(); i++) {
+	size_t i = 0;
+	for (; reader.next(); i++) {
+		const vector<uint8_t>& frame = reader.frame();
 		file << "Vector " << i << ":\n";
-		for (size_t j = 0; j < results[i].size(); j++) {
-			if (results[i][j]) file << std::setw(4) << static_cast<int>(results[i][j]);
+		for (size_t j = 0; j < frame.size(); j++) {
+			if (frame[j]) file << std::setw(4) << static_cast<int>(frame[j]);
 			else file << "....";
 			//file << "\t";
 
@@ -248,6 +401,8 @@ void preview_in_txt(const std::vector<std::vector<uint8_t>>& results, int column
 	}
 
 	file.close();
+	std::cout << "Wrote " << i << " frames to " << text_path << "." << std::endl;
+	return 0;
 }
 
 #ifdef USE_OPENGL_FOR_PREVIEW
@@ -260,44 +415,46 @@ void preview_in_txt(const std::vector<std::vector<uint8_t>>& results, int column
 using namespace std;
 
 void init();
-void plot(const vector<vector<uint8_t>>& results, int rows, int columns);
+void plot(FrameReader& reader, int rows, int columns);
 
 class Renderer {
 // because 'raw' global variables are bad or something?
 public:
-	static void set(const vector<vector<uint8_t>>& results, int rows, int columns) {
-		Renderer::results = results;
-		Renderer::rows = rows;
-		Renderer::columns = columns;
+	static void set(FrameReader* reader) {
+		Renderer::reader = reader;
+		Renderer::rows = (int)reader->header().rows;
+		Renderer::columns = (int)reader->header().columns;
 	};
 
 	static void call() {
-		plot(results, rows, columns);
+		plot(*reader, rows, columns);
 	};
 
-	static vector<vector<uint8_t>> results;
+	// frames are decoded from the stream one at a time as they are shown, so it never has to fit in memory
+	static FrameReader* reader;
 	static int rows;
 	static int columns;
 };
 
-vector<vector<uint8_t>> Renderer::results;
+FrameReader* Renderer::reader = nullptr;
 int Renderer::rows = 0;
 int Renderer::columns = 0;
 
-int result_size = 0;
-int current_result = 0;
+int preview_in_gl(const std::string& frames_path) {
+	static FrameReader reader(frames_path);
+	if (!reader.is_open()) return 1;
+	if (!reader.next()) {
+		std::cerr << "Error: " << frames_path << " has no frames.\n";
+		return 1;
+	}
 
-void preview_in_gl(const vector<vector<uint8_t>>& results, int rows, int columns) {
 	int mode = GLUT_DOUBLE | GLUT_RGB;
 
 	int fake_argc = 1;
 	char* fake_argv[] = { (char*)"ParallelProcessing.exe", nullptr };
 	glutInit(&fake_argc, fake_argv);
 
-	Renderer::set(results, rows, columns);
-
-	result_size = results.size();
-	current_result = 0;
+	Renderer::set(&reader);
 
 	glutInitDisplayMode(mode);
 	glutInitWindowSize(1000, 1000);
@@ -307,6 +464,7 @@ void preview_in_gl(const vector<vector<uint8_t>>& results, int rows, int columns
 	glutDisplayFunc(Renderer::call);
 	glutIdleFunc(Renderer::call);
 	glutMainLoop();
+	return 0;
 }
 
 void init() {
@@ -323,19 +481,24 @@ void init() {
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
-void plot(const vector<vector<uint8_t>>& results, int rows, int columns) {
+void plot(FrameReader& reader, int rows, int columns) {
 	glClear(GL_COLOR_BUFFER_BIT);
 	glBegin(GL_POINTS);
 
+	const vector<uint8_t>& frame = reader.frame();
 	for (int i = 0; i < rows; i++) {
 		for (int j = 0; j < columns; j++) {
-			glColor3ub(results[current_result][i * columns + j], 0, 0);
+			glColor3ub(frame[i * columns + j], 0, 0);
 			glVertex2i(j, i);
 		}
 	}
 
 	glEnd();
-	current_result = (current_result + 1) % result_size;
+	// back to the start after the last frame
+	if (!reader.next()) {
+		reader.rewind();
+		reader.next();
+	}
 
 	// this is some double buffering magic. all i know is that it makes everything work.
 	glutSwapBuffers();
@@ -0,0 +1,143 @@
+#include "checkpoint.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+/**
+* The view of the file that selects a block of one copy of the field.
+*/
+static MPI_Datatype block_filetype(const CheckpointHeader& header, BlockRange rows, BlockRange columns) {
+	int sizes[2] = { (int)header.rows, (int)header.columns };
+	int subsizes[2] = { rows.count, columns.count };
+	int starts[2] = { rows.start, columns.start };
+	MPI_Datatype filetype;
+	MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &filetype);
+	MPI_Type_commit(&filetype);
+	return filetype;
+}
+
+static MPI_Offset slot_offset(const CheckpointHeader& header, int slot) {
+	return sizeof(CheckpointHeader) + (MPI_Offset)slot * header.rows * header.columns * sizeof(double);
+}
+
+bool read_checkpoint_header(const std::string& path, CheckpointHeader& header, MPI_Comm comm) {
+	int rank;
+	MPI_Comm_rank(comm, &rank);
+
+	int ok = 0;
+	if (rank == 0) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			std::cerr << "Error opening " << path << " for reading.\n";
+		}
+		else {
+			std::streamoff file_size = file.tellg();
+			file.seekg(0);
+			if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "PCHC", 4) != 0) {
+				std::cerr << "Error: " << path << " is not a checkpoint, or no checkpoint in it was finished.\n";
+			}
+			else if (header.version != CHECKPOINT_FILE_VERSION || header.slot > 1) {
+				std::cerr << "Error: " << path << " has an unsupported version.\n";
+			}
+			else if (file_size < slot_offset(header, 2)) {
+				std::cerr << "Error: " << path << " is shorter than its header says.\n";
+			}
+			else {
+				ok = 1;
+			}
+		}
+	}
+
+	MPI_Bcast(&ok, 1, MPI_INT, 0, comm);
+	if (ok) MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, comm);
+	return ok;
+}
+
+bool read_checkpoint(const std::string& path, const CheckpointHeader& header, BlockRange rows, BlockRange columns, double* cells, int stride, MPI_Comm comm) {
+	MPI_File file;
+	if (MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+		return false;
+	}
+
+	// straight into the block, around its ghost cells
+	MPI_Datatype memtype;
+	MPI_Type_vector(rows.count, columns.count, stride, MPI_DOUBLE, &memtype);
+	MPI_Type_commit(&memtype);
+	MPI_Datatype filetype = block_filetype(header, rows, columns);
+
+	MPI_File_set_view(file, slot_offset(header, header.slot), MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+	int rc = MPI_File_read_at_all(file, 0, cells, 1, memtype, MPI_STATUS_IGNORE);
+
+	MPI_Type_free(&filetype);
+	MPI_Type_free(&memtype);
+	MPI_File_close(&file);
+
+	int ok = rc == MPI_SUCCESS;
+	MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+	return ok;
+}
+
+Checkpointer::Checkpointer(const std::string& path, const HeatProblem& problem, BlockRange rows, BlockRange columns, bool restarted_from_path, int first_slot, MPI_Comm comm)
+	: m_comm(comm), m_rows(rows), m_columns(columns), m_slot(first_slot) {
+	m_header = { { 'P', 'C', 'H', 'C' }, CHECKPOINT_FILE_VERSION, (uint32_t)problem.rows, (uint32_t)problem.columns,
+		(uint32_t)problem.step_interval, (uint32_t)problem.boundary, 0, 0, 0 };
+	m_field_bytes = (size_t)problem.rows * problem.columns * sizeof(double);
+	m_filetype = block_filetype(m_header, rows, columns);
+	m_staging.resize((size_t)rows.count * columns.count);
+
+	// not truncated on open, carrying on in the file a run was restarted from mustn't lose the checkpoint the header points at
+	if (MPI_File_open(comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &m_file) != MPI_SUCCESS) {
+		int rank;
+		MPI_Comm_rank(comm, &rank);
+		if (rank == 0) std::cerr << "Error opening " << path << " for writing, no checkpoints will be written.\n";
+		m_file = MPI_FILE_NULL;
+		return;
+	}
+	// anything else in the file is from another run, and its header could point at a copy this run is half way through overwriting
+	if (!restarted_from_path) MPI_File_set_size(m_file, 0);
+	MPI_File_set_size(m_file, slot_offset(m_header, 2));
+}
+
+Checkpointer::~Checkpointer() {
+	finish();
+	if (m_file != MPI_FILE_NULL) MPI_File_close(&m_file);
+	MPI_Type_free(&m_filetype);
+}
+
+void Checkpointer::start(const double* cells, int stride, long long step) {
+	if (!is_open()) return;
+	finish();
+
+	Timer start_timer;
+	for (int i = 0; i < m_rows.count; i++) {
+		std::memcpy(m_staging.data() + (size_t)i * m_columns.count, cells + (size_t)i * stride, m_columns.count * sizeof(double));
+	}
+
+	MPI_File_set_view(m_file, slot_offset(m_header, m_slot), MPI_DOUBLE, m_filetype, "native", MPI_INFO_NULL);
+	MPI_File_iwrite_at_all(m_file, 0, m_staging.data(), (int)m_staging.size(), MPI_DOUBLE, &m_request);
+	m_header.step = (uint64_t)step;
+	m_writing = true;
+	m_start_time += start_timer.stop().count();
+}
+
+void Checkpointer::finish() {
+	if (!m_writing) return;
+
+	Timer finish_timer;
+	MPI_Wait(&m_request, MPI_STATUS_IGNORE);
+	// the field has to be on disk before the header points at it
+	MPI_File_sync(m_file);
+
+	int rank;
+	MPI_Comm_rank(m_comm, &rank);
+	m_header.slot = (uint32_t)m_slot;
+	MPI_File_set_view(m_file, 0, MPI_BYTE, MPI_BYTE, "native", MPI_INFO_NULL);
+	if (rank == 0) MPI_File_write_at(m_file, 0, &m_header, sizeof(m_header), MPI_BYTE, MPI_STATUS_IGNORE);
+	MPI_File_sync(m_file);
+
+	m_slot ^= 1;
+	m_writing = false;
+	m_checkpoints++;
+	m_finish_time += finish_timer.stop().count();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "heat.h"
+
+#include <mpi.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+* On-disk checkpoint format: a 40 byte header followed by two copies of the rows × columns field, row-major doubles,
+* in the byte order of the machine that wrote it. Checkpoints go to the two copies in turn, and the header only points at one
+* once all of it is on disk, so a job killed in the middle of a checkpoint still leaves the one before it intact.
+*/
+struct CheckpointHeader {
+	char magic[4];			// "PCHC"
+	uint32_t version;
+	uint32_t rows;
+	uint32_t columns;
+	uint32_t step_interval;	// ms
+	uint32_t boundary;		// a BoundaryCondition
+	uint64_t step;			// steps already taken
+	uint32_t slot;			// the copy of the field that holds them
+	uint32_t reserved;
+};
+static_assert(sizeof(CheckpointHeader) == 40, "CheckpointHeader must match the on-disk layout");
+
+constexpr uint32_t CHECKPOINT_FILE_VERSION = 1;
+
+/**
+* Reads and checks a checkpoint's header on rank 0 and shares it with the rest of comm.
+* @return Whether the file has a valid header, the same on every rank.
+*/
+bool read_checkpoint_header(const std::string& path, CheckpointHeader& header, MPI_Comm comm);
+
+/**
+* Collectively reads every rank's block of the field from a checkpoint with MPI-IO. The blocks don't have to be the ones
+* it was written with, so a run can carry on with a different number of processes.
+* cells points at the block's first cell, and its rows are stride apart.
+* @return Whether the read succeeded, the same on every rank.
+*/
+bool read_checkpoint(const std::string& path, const CheckpointHeader& header, BlockRange rows, BlockRange columns, double* cells, int stride, MPI_Comm comm);
+
+/**
+* Writes checkpoints of a field split into blocks over comm, every rank writing its own block into the one shared file.
+* The block is copied out and the write is started with MPI_File_iwrite_at_all, so it goes on behind the next steps.
+* Every call is collective.
+*/
+class Checkpointer {
+public:
+	/**
+	* @param restarted_from_path Whether the run restarted from the checkpoint in this file, which is kept until there is a newer one.
+	* Any other file is emptied first, so an old checkpoint in it can't be mistaken for one of this run.
+	* @param first_slot The copy of the field to write first, the one the header isn't pointing at when carrying on in the same file.
+	*/
+	Checkpointer(const std::string& path, const HeatProblem& problem, BlockRange rows, BlockRange columns, bool restarted_from_path, int first_slot, MPI_Comm comm);
+	~Checkpointer();
+
+	Checkpointer(const Checkpointer&) = delete;
+	Checkpointer& operator=(const Checkpointer&) = delete;
+
+	bool is_open() const { return m_file != MPI_FILE_NULL; }
+
+	/**
+	* Finishes the checkpoint before, if there is one, then starts writing this block as the state after step steps.
+	*/
+	void start(const double* cells, int stride, long long step);
+
+	/**
+	* Waits for the checkpoint being written, and points the header at it.
+	*/
+	void finish();
+
+	int checkpoints() const { return m_checkpoints; }
+	size_t field_bytes() const { return m_field_bytes; }
+	// time spent in start(), copying the block and starting the write, and in finish(), waiting for it and updating the header
+	double start_time() const { return m_start_time; }
+	double finish_time() const { return m_finish_time; }
+
+private:
+	MPI_File m_file = MPI_FILE_NULL;
+	MPI_Comm m_comm;
+	MPI_Datatype m_filetype;
+	CheckpointHeader m_header;
+	size_t m_field_bytes;
+	BlockRange m_rows;
+	BlockRange m_columns;
+	std::vector<double> m_staging; // the block being written, so the simulation can carry on with its own copy
+
+	int m_slot;
+	bool m_writing = false;
+	MPI_Request m_request = MPI_REQUEST_NULL;
+
+	int m_checkpoints = 0;
+	double m_start_time = 0;
+	double m_finish_time = 0;
+};
@@ -0,0 +1,189 @@
+#include "frames.h"
+#include "heat.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// zeros in a row it takes to be worth ending a run of literal bytes, since starting a new pair costs two bytes
+constexpr size_t MIN_ZERO_RUN = 3;
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static bool get_varint(const uint8_t* data, size_t size, size_t& position, uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (position >= size) return false;
+		uint8_t byte = data[position++];
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+void FrameCoding::encode(const uint8_t* frame, const uint8_t* previous, size_t cells, std::vector<uint8_t>& out) {
+	size_t i = 0;
+	while (i < cells) {
+		size_t zeros = 0;
+		while (i + zeros < cells && frame[i + zeros] == previous[i + zeros]) zeros++;
+		i += zeros;
+
+		// literals go on until there are enough unchanged cells in a row for a new pair, or the frame ends
+		size_t first_literal = i;
+		while (i < cells) {
+			if (frame[i] != previous[i]) {
+				i++;
+				continue;
+			}
+			size_t run = 0;
+			while (run < MIN_ZERO_RUN && i + run < cells && frame[i + run] == previous[i + run]) run++;
+			if (run == MIN_ZERO_RUN || i + run == cells) break;
+			i += run;
+		}
+
+		put_varint(out, zeros);
+		put_varint(out, i - first_literal);
+		for (size_t j = first_literal; j < i; j++) out.push_back((uint8_t)(frame[j] - previous[j]));
+	}
+}
+
+bool FrameCoding::decode(const uint8_t* data, size_t size, uint8_t* previous, size_t cells) {
+	size_t position = 0;
+	size_t i = 0;
+	while (i < cells) {
+		uint64_t zeros;
+		uint64_t literals;
+		if (!get_varint(data, size, position, zeros) || !get_varint(data, size, position, literals)) return false;
+		if (zeros > cells - i) return false;
+		i += zeros;
+		if (literals > cells - i || literals > size - position) return false;
+		for (size_t j = 0; j < literals; j++) previous[i + j] += data[position + j];
+		i += literals;
+		position += literals;
+	}
+	return position == size;
+}
+
+FrameWriter::FrameWriter(const std::string& path, int rows, int columns, int frame_stride)
+	: m_file(path, std::ios::binary), m_cells((size_t)rows * columns), m_frame_stride(frame_stride) {
+	if (!m_file) {
+		std::cerr << "Error opening " << path << " for writing.\n";
+		return;
+	}
+
+	FrameHeader header = { { 'P', 'C', 'H', 'F' }, FRAME_FILE_VERSION, (uint32_t)rows, (uint32_t)columns, (uint32_t)frame_stride, 0 };
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	m_buffers[0].resize(m_cells);
+	m_buffers[1].resize(m_cells);
+	m_previous.assign(m_cells, 0);
+	m_open = true;
+	m_thread = std::thread(&FrameWriter::work, this);
+}
+
+FrameWriter::~FrameWriter() {
+	close();
+}
+
+void FrameWriter::write(const double* field) {
+	if (!m_open) return;
+
+	Timer wait_timer;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [&] { return !m_full[m_filling]; });
+	}
+	m_wait_time += wait_timer.stop().count();
+
+	uint8_t* frame = m_buffers[m_filling].data();
+	for (size_t i = 0; i < m_cells; i++) frame[i] = (uint8_t)(field[i] / MAX_TEMP * 255);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_full[m_filling] = true;
+	}
+	m_changed.notify_all();
+	m_filling ^= 1;
+	m_frames++;
+}
+
+void FrameWriter::close() {
+	if (!m_thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closing = true;
+	}
+	m_changed.notify_all();
+	m_thread.join();
+	m_file.close();
+}
+
+void FrameWriter::work() {
+	// the buffers are taken in the order they were filled
+	int next = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_changed.wait(lock, [&] { return m_full[next] || m_closing; });
+			if (!m_full[next]) break;
+		}
+
+		const uint8_t* frame = m_buffers[next].data();
+		m_coded.clear();
+		FrameCoding::encode(frame, m_previous.data(), m_cells, m_coded);
+		uint32_t size = (uint32_t)m_coded.size();
+		m_file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		m_file.write(reinterpret_cast<const char*>(m_coded.data()), m_coded.size());
+		m_coded_bytes += sizeof(size) + m_coded.size();
+		std::memcpy(m_previous.data(), frame, m_cells);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_full[next] = false;
+		}
+		m_changed.notify_all();
+		next ^= 1;
+	}
+}
+
+FrameReader::FrameReader(const std::string& path) : m_file(path, std::ios::binary) {
+	if (!m_file) {
+		std::cerr << "Error opening " << path << " for reading.\n";
+		return;
+	}
+
+	if (!m_file.read(reinterpret_cast<char*>(&m_header), sizeof(m_header)) || std::memcmp(m_header.magic, "PCHF", 4) != 0) {
+		std::cerr << "Error: " << path << " is not a frame stream.\n";
+		return;
+	}
+
+	if (m_header.version != FRAME_FILE_VERSION) {
+		std::cerr << "Error: " << path << " has an unsupported version.\n";
+		return;
+	}
+
+	m_frame.assign((size_t)m_header.rows * m_header.columns, 0);
+	m_open = true;
+}
+
+bool FrameReader::next() {
+	if (!m_open) return false;
+
+	uint32_t size;
+	if (!m_file.read(reinterpret_cast<char*>(&size), sizeof(size))) return false;
+	m_coded.resize(size);
+	if (!m_file.read(reinterpret_cast<char*>(m_coded.data()), size)) return false;
+	return FrameCoding::decode(m_coded.data(), m_coded.size(), m_frame.data(), m_frame.size());
+}
+
+void FrameReader::rewind() {
+	m_file.clear();
+	m_file.seekg(sizeof(FrameHeader));
+	std::fill(m_frame.begin(), m_frame.end(), 0);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+* On-disk frame stream: a 24 byte header, then one record per frame, each a uint32_t byte count followed by that many bytes.
+* A frame is the field as one byte per cell, 0 for cold and 255 for MAX_TEMP. Each one is stored as its difference from the frame before
+* (byte by byte, wrapping around), which is mostly zeros, run-length coded as pairs of
+* (varint number of zeros, varint number of literal bytes, the literal bytes) until the frame is full.
+* The number of frames isn't stored anywhere, so the stream can be read while it is still being written.
+*/
+struct FrameHeader {
+	char magic[4];			// "PCHF"
+	uint32_t version;
+	uint32_t rows;
+	uint32_t columns;
+	uint32_t frame_stride;	// steps between frames
+	uint32_t reserved;
+};
+static_assert(sizeof(FrameHeader) == 24, "FrameHeader must match the on-disk layout");
+
+constexpr uint32_t FRAME_FILE_VERSION = 1;
+
+namespace FrameCoding {
+	/**
+	* Appends frame, coded against previous, to out.
+	*/
+	void encode(const uint8_t* frame, const uint8_t* previous, size_t cells, std::vector<uint8_t>& out);
+
+	/**
+	* Turns previous into the frame coded in data, in place.
+	* @return false if data isn't a valid frame of that many cells.
+	*/
+	bool decode(const uint8_t* data, size_t size, uint8_t* previous, size_t cells);
+}
+
+/**
+* Writes frames to a stream as the simulation goes, instead of keeping them all in memory.
+* The caller turns the field into bytes in one buffer while a background thread codes and writes the other,
+* so the simulation only waits if the thread is still busy with the frame before the last one.
+*/
+class FrameWriter {
+public:
+	FrameWriter(const std::string& path, int rows, int columns, int frame_stride);
+	~FrameWriter();
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	bool is_open() const { return m_open; }
+	int frame_stride() const { return m_frame_stride; }
+
+	/**
+	* Adds a frame of the rows × columns field.
+	*/
+	void write(const double* field);
+
+	/**
+	* Writes out the frames still in the buffers and closes the file.
+	*/
+	void close();
+
+	size_t frames() const { return m_frames; }
+	// before and after coding
+	uint64_t raw_bytes() const { return (uint64_t)m_frames * m_cells; }
+	uint64_t coded_bytes() const { return m_coded_bytes; }
+	// how long write() had to wait for the background thread
+	double wait_time() const { return m_wait_time; }
+
+private:
+	void work();
+
+	std::ofstream m_file;
+	bool m_open = false;
+	size_t m_cells;
+	int m_frame_stride;
+
+	std::vector<uint8_t> m_buffers[2];
+	bool m_full[2] = { false, false }; // waiting for or being written by the thread
+	int m_filling = 0; // the buffer the next frame goes into
+	bool m_closing = false;
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::thread m_thread;
+
+	// the thread's own
+	std::vector<uint8_t> m_previous;
+	std::vector<uint8_t> m_coded;
+	uint64_t m_coded_bytes = 0;
+
+	size_t m_frames = 0;
+	double m_wait_time = 0;
+};
+
+/**
+* Reads a frame stream back, one frame at a time.
+*/
+class FrameReader {
+public:
+	explicit FrameReader(const std::string& path);
+
+	bool is_open() const { return m_open; }
+	const FrameHeader& header() const { return m_header; }
+	size_t cells() const { return m_frame.size(); }
+
+	/**
+	* Decodes the next frame.
+	* @return false at the end of the stream, or if the frame is damaged.
+	*/
+	bool next();
+
+	/**
+	* Goes back to before the first frame.
+	*/
+	void rewind();
+
+	const std::vector<uint8_t>& frame() const { return m_frame; }
+
+private:
+	std::ifstream m_file;
+	bool m_open = false;
+	FrameHeader m_header;
+	std::vector<uint8_t> m_frame;
+	std::vector<uint8_t> m_coded;
+};
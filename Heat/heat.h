@@ -0,0 +1,146 @@
+#pragma once
+
+#include "../programs.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+constexpr double MAX_TEMP = 1000.0;
+
+constexpr double grid_distance = 0.001; // 0.001 meters = 1 mm
+constexpr double thermal_diffusivity = 23e-6; // alpha for iron is 2.3 × 10^(-5) m^2/s
+
+enum class BoundaryCondition {
+	// this was an interesting rabbit hole.
+	Neumann,	// no heat loss to boundary
+	Dirichlet,	// boundary is absolute zero❅
+	//Convective,	// boundary is air~~
+	// (not implemented because i've had enough of thermodynamics for one day)
+	// (actually, enough for a lifetime)
+};
+
+double boundary_adjusted_temp(double self_temp, BoundaryCondition condition = BoundaryCondition::Neumann);
+
+/**
+* A cell held at a fixed temperature for the whole run.
+*/
+struct HeatSource {
+	int row;
+	int column;
+	double temperature;
+};
+
+inline const HeatSource HEAT_SOURCES[] = {
+	{ 10, 10, MAX_TEMP },
+	{ 40, 25, MAX_TEMP },
+};
+
+struct HeatProblem {
+	int rows;
+	int columns;
+	int step_interval; // ms
+	int num_steps;
+	BoundaryCondition boundary = BoundaryCondition::Neumann;
+
+	/**
+	* alpha * dt / dx^2, the factor in front of the neighbours' difference in the update.
+	*/
+	double coefficient() const {
+		return thermal_diffusivity * (step_interval / 1000.0) / (grid_distance * grid_distance);
+	}
+
+	/**
+	* The longest step, in ms, that explicit updates are stable with, where coefficient() is 1/4.
+	*/
+	static double stable_step_interval() {
+		return 0.25 * grid_distance * grid_distance / thermal_diffusivity * 1000.0;
+	}
+
+	bool contains(int row, int column) const {
+		return row >= 0 && row < rows && column >= 0 && column < columns;
+	}
+};
+
+enum class Decomposition {
+	Rows,	// every process gets whole rows
+	Blocks	// a 2D grid of processes, each with a block of rows and columns
+};
+
+enum class Integrator {
+	Explicit,		// forward Euler, only stable up to HeatProblem::stable_step_interval()
+	CrankNicolson,	// implicit, second order in time
+	BackwardEuler	// implicit, first order, but damps the sharp edges around the sources instead of ringing
+};
+
+struct ResidentOptions {
+	// the whole field is gathered on rank 0 every this many steps, never if 0
+	int output_interval = 1;
+	// exchange ghost rows with persistent requests, and update the interior rows while they are in flight
+	bool persistent_halo = false;
+	Decomposition decomposition = Decomposition::Rows;
+	// the process grid for Blocks, picked from the shape of the grid if not given
+	int process_rows = 0;
+	int process_columns = 0;
+	// steps taken between ghost cell exchanges, with ghost borders that deep. 0 picks it from the measured latency
+	int time_block = 1;
+	// the field is checkpointed to checkpoint_path every this many steps, never if 0
+	int checkpoint_interval = 0;
+	std::string checkpoint_path;
+	// carry on from the checkpoint in this file, if it isn't empty
+	std::string restart_path;
+	Integrator integrator = Integrator::Explicit;
+	// implicit steps stop iterating once the residual is this much smaller than the right hand side,
+	// and the steady state solver once it is this much smaller than where it started
+	double solver_tolerance = 1e-10;
+	// conjugate gradient iterations per implicit step, or multigrid cycles for the steady state
+	int max_iterations = 1000;
+	// the run ends early once the largest change of a cell in one step stays below this, never if 0.
+	// The change is checked every check_interval steps
+	double steady_tolerance = 0;
+	int check_interval = 10;
+};
+
+/**
+* Sets the sources inside a block of the grid. cells points at the block's first cell, and its rows are stride apart.
+* Sources outside the grid are ignored.
+*/
+inline void apply_sources(const HeatProblem& problem, double* cells, BlockRange rows, BlockRange columns, int stride) {
+	for (const HeatSource& source : HEAT_SOURCES) {
+		if (!problem.contains(source.row, source.column)) continue;
+		if (source.row < rows.start || source.row >= rows.end() || source.column < columns.start || source.column >= columns.end()) continue;
+		cells[(size_t)(source.row - rows.start) * stride + (source.column - columns.start)] = source.temperature;
+	}
+}
+
+/**
+* Adds up a hash of every cell's bits and position in a block of a grid with grid_columns columns, laid out like in apply_sources.
+* Addition doesn't care about order, so ranks can add up their own blocks and the total matches only if every cell does, bit for bit.
+*/
+inline uint64_t field_fingerprint(const double* cells, BlockRange rows, BlockRange columns, int grid_columns, int stride) {
+	uint64_t fingerprint = 0;
+	for (int i = 0; i < rows.count; i++) {
+		for (int j = 0; j < columns.count; j++) {
+			uint64_t bits;
+			std::memcpy(&bits, cells + (size_t)i * stride + j, sizeof(bits));
+			uint64_t position = (uint64_t)(rows.start + i) * grid_columns + columns.start + j;
+			fingerprint += RandomTools::mix(bits ^ RandomTools::mix(position));
+		}
+	}
+	return fingerprint;
+}
+
+class FrameWriter;
+
+/**
+* Runs the simulation with every rank keeping its block for the whole run, only exchanging ghost cells with its neighbours.
+* Frames gathered on rank 0 go to frames, which is only used there.
+*/
+int run_resident(const HeatProblem& problem, const ResidentOptions& options, FrameWriter* frames);
+
+/**
+* Solves for the field the simulation settles into, with multigrid over slabs of rows instead of taking steps.
+* The field is written to frames as the only frame, if options.output_interval isn't 0.
+*/
+int run_steady_state(const HeatProblem& problem, const ResidentOptions& options, FrameWriter* frames);
@@ -0,0 +1,581 @@
+#include "frames.h"
+#include "heat.h"
+#include "resident.h"
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::vector;
+
+// red-black Gauss-Seidel sweeps before and after the correction from the level below
+constexpr int PRE_SMOOTHING = 2;
+constexpr int POST_SMOOTHING = 2;
+// a level this small in both directions isn't coarsened any further, just swept until it is solved
+constexpr int COARSEST_SIZE = 4;
+constexpr int COARSEST_SWEEPS = 50;
+// a correction that is constant over each coarse cell has steps between them that cost energy the smooth error doesn't have,
+// which makes the coarse matrix about twice too stiff, so the correction is scaled up to make up for it
+constexpr double CORRECTION_SCALE = 1.8;
+// once a level would leave a process fewer rows than this, the levels below it are agglomerated onto process 0
+constexpr int MIN_ROWS_PER_PROCESS = 4;
+
+/**
+* One level of the hierarchy, holding the matrix A of the level as a five point stencil with a coefficient per cell:
+* (A x)[cell] = diagonal x[cell] - up x[above] - left x[left of it] - (up below) x[below] - (left to the right) x[right of it],
+* so each coupling is stored once, on the cell below or to the right of it. Cells that aren't free are held fixed.
+*/
+struct Level {
+	Tile field; // the correction being solved for
+	Tile rhs;
+	Tile residual;
+	Tile free; // 1 for the cells being solved for, 0 for the ones held fixed
+	Tile diagonal;
+	Tile scale; // free / diagonal, how far Gauss-Seidel moves a cell per unit of its residual
+	Tile up;
+	Tile left;
+	int grid_rows; // of the whole level, on every process
+	vector<BlockRange> process_rows; // every process's rows, by rank
+	std::unique_ptr<HaloMessages> messages;
+
+	Level(const ProcessGrid& grid, const vector<BlockRange>& process_rows, int columns)
+		: field(process_rows[grid.rank], { 0, columns }, 1), rhs(field), residual(field), free(field), diagonal(field), scale(field), up(field), left(field),
+		process_rows(process_rows) {
+		grid_rows = process_rows.back().end();
+		messages = std::make_unique<HaloMessages>(grid, field.rows.count, columns, field.stride, 1);
+	}
+
+	int rows() const { return field.rows.count; }
+	int columns() const { return field.columns.count; }
+
+	/**
+	* (A x) for cell j of row i, with x's ghost rows filled.
+	*/
+	double product(const Tile& x, int i, int j) const {
+		const double* here = x.row(i);
+		return diagonal.row(i)[j] * here[j] - up.row(i)[j] * x.row(i - 1)[j] - up.row(i + 1)[j] * x.row(i + 1)[j]
+			- left.row(i)[j] * here[j - 1] - left.row(i)[j + 1] * here[j + 1];
+	}
+};
+
+/**
+* Geometric multigrid over slabs of rows, for the steady state. Each level has half the rows and columns of the one above,
+* every coarse cell standing for the up to 2 × 2 fine cells it covers, and a process owns the coarse rows whose first fine row it owns,
+* so all it needs from its neighbours are the ghost rows it already exchanges. Every sweep, residual and correction exchanges them first.
+* The correction is the coarse cell's value in all of its fine cells, the restriction adds their residuals up, and the coarse matrix is
+* the fine one projected through them, which keeps it a five point stencil and takes the boundary and the sources along exactly,
+* whatever the shape of the grid. Once the levels get too small to be worth splitting, the rest of them are gathered onto process 0.
+* A V-cycle is symmetric, so it preconditions conjugate gradients, which makes up for the coarse levels only being approximate.
+*/
+class Multigrid {
+public:
+	/**
+	* Builds the levels for the grid's own matrix, with the shape of free, which holds the cells being solved for. Collective over grid.
+	*/
+	Multigrid(const ProcessGrid& grid, const Tile& free, BoundaryCondition boundary) : m_grid(grid) {
+		vector<BlockRange> process_rows(grid.size);
+		MPI_Allgather(&free.rows, 2, MPI_INT, process_rows.data(), 2, MPI_INT, grid.comm);
+		int columns = free.columns.count;
+		m_levels.emplace_back(grid, process_rows, columns);
+		Level& top = m_levels.back();
+		top.free.cells = free.cells;
+
+		// every neighbour inside the grid counts once. Past a Dirichlet edge the neighbour is 0, past a Neumann edge it is the cell itself,
+		// which takes it off the diagonal
+		for (int i = 0; i < top.rows(); i++) {
+			int grid_row = top.field.rows.start + i;
+			for (int j = 0; j < columns; j++) {
+				int neighbours = (grid_row > 0) + (grid_row < top.grid_rows - 1) + (j > 0) + (j < columns - 1);
+				top.up.row(i)[j] = (grid_row > 0);
+				top.left.row(i)[j] = (j > 0);
+				top.diagonal.row(i)[j] = (boundary == BoundaryCondition::Dirichlet) ? 4.0 : neighbours;
+			}
+		}
+		build();
+	}
+
+	~Multigrid() {
+		if (m_agglomerating) {
+			MPI_Type_free(&m_block_type);
+			MPI_Type_free(&m_row_type);
+		}
+	}
+
+	Multigrid(const Multigrid&) = delete;
+	Multigrid& operator=(const Multigrid&) = delete;
+
+	/**
+	* Solves for the field that the first level's matrix takes to 0 in the free cells, holding the others at their values in field,
+	* with conjugate gradients preconditioned by a V-cycle.
+	* @return The iterations taken. They stop once the residual is tolerance times smaller than where it started, or after max_iterations.
+	*/
+	int solve(Tile& field, double tolerance, int max_iterations) {
+		Level& top = m_levels[0];
+		Tile residual = top.field;
+		Tile preconditioned = top.field;
+		Tile direction = top.field;
+		Tile product = top.field;
+
+		apply(field, product);
+		for_each_row(top, [&](int i) {
+			for (int j = 0; j < top.columns(); j++) residual.row(i)[j] = -product.row(i)[j];
+		});
+		m_initial_norm = std::sqrt(dot(residual, residual));
+		m_final_norm = m_initial_norm;
+
+		int iteration = 0;
+		if (m_initial_norm == 0) return iteration;
+		precondition(residual, preconditioned);
+		direction.cells = preconditioned.cells;
+		double residual_dot = dot(residual, preconditioned);
+
+		while (iteration < max_iterations) {
+			apply(direction, product);
+			double alpha = residual_dot / dot(direction, product);
+			for_each_row(top, [&](int i) {
+				for (int j = 0; j < top.columns(); j++) {
+					field.row(i)[j] += alpha * direction.row(i)[j];
+					residual.row(i)[j] -= alpha * product.row(i)[j];
+				}
+			});
+			iteration++;
+
+			m_final_norm = std::sqrt(dot(residual, residual));
+			if (m_final_norm <= tolerance * m_initial_norm) break;
+
+			precondition(residual, preconditioned);
+			double new_dot = dot(residual, preconditioned);
+			double beta = new_dot / residual_dot;
+			residual_dot = new_dot;
+			for_each_row(top, [&](int i) {
+				for (int j = 0; j < top.columns(); j++) direction.row(i)[j] = preconditioned.row(i)[j] + beta * direction.row(i)[j];
+			});
+		}
+		return iteration;
+	}
+
+	// the 2-norm of the residual before and after solve()
+	double initial_norm() const { return m_initial_norm; }
+	double final_norm() const { return m_final_norm; }
+
+	/**
+	* @return The sizes of the levels, the agglomerated ones only on process 0.
+	*/
+	std::string levels() const {
+		std::string description;
+		for (const Level& level : m_levels) {
+			if (!description.empty()) description += ", ";
+			description += std::to_string(level.grid_rows) + " x " + std::to_string(level.columns());
+		}
+		if (m_agglomerated) description += ", then on process 0: " + m_agglomerated->levels();
+		return description;
+	}
+
+	double halo_time() const { return m_halo_time; }
+	double reduce_time() const { return m_reduce_time; }
+	// gathering the coarsest split level, cycling below it on process 0 and scattering the correction back
+	double agglomerated_time() const { return m_agglomerated_time; }
+
+private:
+	/**
+	* For the levels on process 0, whose first level is the processes' coarsest one.
+	*/
+	Multigrid(const ProcessGrid& grid, Level&& top) : m_grid(grid) {
+		m_levels.push_back(std::move(top));
+		build();
+	}
+
+	/**
+	* Adds the levels below the first one, and hands the rest to process 0 if the processes run out of rows first.
+	*/
+	void build() {
+		prepare(m_levels.back());
+		while (true) {
+			Level& fine = m_levels.back();
+			if (fine.grid_rows <= COARSEST_SIZE && fine.columns() <= COARSEST_SIZE) break;
+
+			// a coarse row starts at every even fine row
+			vector<BlockRange> coarse_rows;
+			bool splittable = true;
+			for (const BlockRange& rows : fine.process_rows) {
+				int start = (rows.start + 1) / 2;
+				coarse_rows.push_back({ start, (rows.end() + 1) / 2 - start });
+				splittable = splittable && coarse_rows.back().count >= MIN_ROWS_PER_PROCESS;
+			}
+			if (m_grid.size > 1 && !splittable) {
+				agglomerate();
+				break;
+			}
+
+			int coarse_columns = (fine.columns() + 1) / 2;
+			m_levels.emplace_back(m_grid, coarse_rows, coarse_columns);
+			project(m_levels[m_levels.size() - 2], m_levels.back());
+			prepare(m_levels.back());
+		}
+	}
+
+	/**
+	* The coarse matrix is R A P, where P copies a coarse cell into its free fine cells and R adds them up.
+	* A coarse cell's diagonal is what its fine cells leave after the couplings among themselves, and its couplings are the fine ones
+	* that cross into the cell above or to the left, only counting the ones between free cells, the correction being 0 in the others.
+	* The fine rows it reads are at most one away from the process's own, so they are in the ghost rows.
+	*/
+	static void project(const Level& fine, Level& coarse) {
+		for (int i = 0; i < coarse.rows(); i++) {
+			int first_row = 2 * (coarse.field.rows.start + i) - fine.field.rows.start;
+			int last_row = std::min(first_row + 2, fine.grid_rows - fine.field.rows.start);
+			for (int j = 0; j < coarse.columns(); j++) {
+				int first_column = 2 * j;
+				int last_column = std::min(first_column + 2, fine.columns());
+				double is_free = 0;
+				double diagonal = 0;
+				double up = 0;
+				double left = 0;
+				for (int r = first_row; r < last_row; r++) {
+					const double* free = fine.free.row(r);
+					const double* free_above = fine.free.row(r - 1);
+					for (int c = first_column; c < last_column; c++) {
+						is_free = std::max(is_free, free[c]);
+						diagonal += free[c] * fine.diagonal.row(r)[c];
+						// couplings inside the coarse cell come off the diagonal once for each end
+						double vertical = fine.up.row(r)[c] * free[c] * free_above[c];
+						if (r > first_row) diagonal -= 2 * vertical;
+						else up += vertical;
+						double horizontal = fine.left.row(r)[c] * free[c] * free[c - 1];
+						if (c > first_column) diagonal -= 2 * horizontal;
+						else left += horizontal;
+					}
+				}
+				coarse.free.row(i)[j] = is_free;
+				coarse.diagonal.row(i)[j] = diagonal;
+				coarse.up.row(i)[j] = up;
+				coarse.left.row(i)[j] = left;
+			}
+		}
+	}
+
+	/**
+	* Fills in the scale of a level whose matrix is set, and fetches the coefficients of its ghost rows,
+	* for the couplings to the row below and for projecting the level below.
+	*/
+	void prepare(Level& level) {
+		for (Tile* tile : { &level.free, &level.diagonal, &level.up, &level.left }) level.messages->exchange(*tile);
+		for_each_row(level, [&](int i) {
+			for (int j = 0; j < level.columns(); j++) {
+				double diagonal = level.diagonal.row(i)[j];
+				level.scale.row(i)[j] = (diagonal > 0) ? level.free.row(i)[j] / diagonal : 0.0;
+			}
+		});
+	}
+
+	template <typename F> static void for_each_row(const Level& level, F&& body) {
+		ThreadPool::instance().parallel_for(0, level.rows(), [&](long long first_row, long long end_row) {
+			for (int i = (int)first_row; i < end_row; i++) body(i);
+		});
+	}
+
+	void exchange(Level& level, Tile& tile) {
+		Timer halo_timer;
+		level.messages->exchange(tile);
+		m_halo_time += halo_timer.stop().count();
+	}
+
+	/**
+	* out = A in on the first level, 0 in the cells held fixed.
+	*/
+	void apply(Tile& in, Tile& out) {
+		Level& level = m_levels[0];
+		exchange(level, in);
+		for_each_row(level, [&](int i) {
+			const double* free = level.free.row(i);
+			double* result = out.row(i);
+			for (int j = 0; j < level.columns(); j++) result[j] = free[j] * level.product(in, i, j);
+		});
+	}
+
+	double dot(const Tile& a, const Tile& b) {
+		const Level& level = m_levels[0];
+		double local = 0;
+		for (int i = 0; i < level.rows(); i++) {
+			const double* x = a.row(i);
+			const double* y = b.row(i);
+			for (int j = 0; j < level.columns(); j++) local += x[j] * y[j];
+		}
+
+		Timer reduce_timer;
+		double total;
+		MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, m_grid.comm);
+		m_reduce_time += reduce_timer.stop().count();
+		return total;
+	}
+
+	/**
+	* correction = one V-cycle for A correction = residual, starting from 0.
+	*/
+	void precondition(const Tile& residual, Tile& correction) {
+		Level& top = m_levels[0];
+		top.rhs.cells = residual.cells;
+		std::fill(top.field.cells.begin(), top.field.cells.end(), 0.0);
+		cycle(0);
+		correction.cells = top.field.cells;
+	}
+
+	/**
+	* The sweeps after the correction go through the colours in the opposite order to the ones before it,
+	* which keeps the cycle symmetric, as conjugate gradients needs its preconditioner to be.
+	*/
+	void cycle(size_t index) {
+		Level& level = m_levels[index];
+		if (index + 1 == m_levels.size()) {
+			if (m_agglomerating) {
+				solve_agglomerated(level);
+				return;
+			}
+			for (int sweep = 0; sweep < COARSEST_SWEEPS; sweep++) {
+				smooth(level, 1, false);
+				smooth(level, 1, true);
+			}
+			return;
+		}
+
+		Level& coarse = m_levels[index + 1];
+		smooth(level, PRE_SMOOTHING, false);
+		compute_residual(level);
+		restrict_residual(level, coarse);
+		std::fill(coarse.field.cells.begin(), coarse.field.cells.end(), 0.0);
+		cycle(index + 1);
+		add_correction(coarse, level);
+		smooth(level, POST_SMOOTHING, true);
+	}
+
+	/**
+	* Red-black Gauss-Seidel. The cells of one colour only have neighbours of the other, so each half of a sweep
+	* can update its cells in any order, split over the threads, after one exchange.
+	*/
+	void smooth(Level& level, int sweeps, bool black_first) {
+		Tile& field = level.field;
+		for (int sweep = 0; sweep < sweeps; sweep++) {
+			for (int half = 0; half < 2; half++) {
+				int colour = black_first ? 1 - half : half;
+				exchange(level, field);
+				for_each_row(level, [&](int i) {
+					double* here = field.row(i);
+					const double* rhs = level.rhs.row(i);
+					const double* scale = level.scale.row(i);
+					for (int j = (field.rows.start + i + colour) % 2; j < level.columns(); j += 2) {
+						here[j] += scale[j] * (rhs[j] - level.product(field, i, j));
+					}
+				});
+			}
+		}
+	}
+
+	void compute_residual(Level& level) {
+		exchange(level, level.field);
+		for_each_row(level, [&](int i) {
+			const double* rhs = level.rhs.row(i);
+			const double* free = level.free.row(i);
+			double* residual = level.residual.row(i);
+			for (int j = 0; j < level.columns(); j++) residual[j] = free[j] * (rhs[j] - level.product(level.field, i, j));
+		});
+	}
+
+	/**
+	* The coarse right hand side is the sum of the residuals of the fine cells each coarse cell covers.
+	*/
+	void restrict_residual(Level& fine, Level& coarse) {
+		// the last coarse row can cover the first row of the process below
+		exchange(fine, fine.residual);
+		for_each_row(coarse, [&](int i) {
+			int first_row = 2 * (coarse.field.rows.start + i) - fine.field.rows.start;
+			int last_row = std::min(first_row + 2, fine.grid_rows - fine.field.rows.start);
+			double* rhs = coarse.rhs.row(i);
+			for (int j = 0; j < coarse.columns(); j++) {
+				double sum = 0;
+				for (int r = first_row; r < last_row; r++) {
+					const double* residual = fine.residual.row(r);
+					for (int c = 2 * j; c < std::min(2 * j + 2, fine.columns()); c++) sum += residual[c];
+				}
+				rhs[j] = sum;
+			}
+		});
+	}
+
+	/**
+	* Adds each coarse cell's correction, scaled, to the free fine cells it covers.
+	*/
+	void add_correction(Level& coarse, Level& fine) {
+		// the first fine row can be covered by the last coarse row of the process above
+		exchange(coarse, coarse.field);
+		for_each_row(fine, [&](int i) {
+			const double* correction = coarse.field.row((fine.field.rows.start + i) / 2 - coarse.field.rows.start);
+			const double* free = fine.free.row(i);
+			double* field = fine.field.row(i);
+			for (int j = 0; j < fine.columns(); j++) field[j] += CORRECTION_SCALE * free[j] * correction[j / 2];
+		});
+	}
+
+	/**
+	* Gathers the coarsest split level's matrix onto process 0, which builds the levels below it on its own,
+	* and sets up the types that carry the level's rows there and back.
+	*/
+	void agglomerate() {
+		m_agglomerating = true;
+		Level& level = m_levels.back();
+		int columns = level.columns();
+		MPI_Type_vector(level.rows(), columns, level.field.stride, MPI_DOUBLE, &m_block_type);
+		MPI_Type_commit(&m_block_type);
+		// one row of the whole level, spaced like the rows of a tile, so the rows land in their place in it
+		MPI_Datatype row;
+		MPI_Type_contiguous(columns, MPI_DOUBLE, &row);
+		MPI_Type_create_resized(row, 0, (MPI_Aint)level.field.stride * sizeof(double), &m_row_type);
+		MPI_Type_commit(&m_row_type);
+		MPI_Type_free(&row);
+		for (const BlockRange& rows : level.process_rows) {
+			m_counts.push_back(rows.count);
+			m_displacements.push_back(rows.start);
+		}
+
+		m_self = { MPI_COMM_SELF, 0, 1, { 1, 1 }, { 0, 0 }, MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL, MPI_PROC_NULL };
+		std::unique_ptr<Level> whole;
+		if (m_grid.rank == 0) whole = std::make_unique<Level>(m_self, vector<BlockRange>{ { 0, level.grid_rows } }, columns);
+		for (Tile Level::* tile : { &Level::free, &Level::diagonal, &Level::up, &Level::left }) {
+			gather(level.*tile, whole ? &(whole.get()->*tile) : nullptr);
+		}
+		if (whole) m_agglomerated.reset(new Multigrid(m_self, std::move(*whole)));
+	}
+
+	void gather(const Tile& tile, Tile* whole) {
+		MPI_Gatherv(tile.row(0), 1, m_block_type, whole ? whole->row(0) : nullptr, m_counts.data(), m_displacements.data(), m_row_type, 0, m_grid.comm);
+	}
+
+	/**
+	* The coarsest split level's residual goes to process 0, which takes a V-cycle for it on the whole level, and the correction comes back.
+	*/
+	void solve_agglomerated(Level& level) {
+		compute_residual(level);
+
+		Timer agglomerated_timer;
+		Level* top = m_agglomerated ? &m_agglomerated->m_levels[0] : nullptr;
+		gather(level.residual, top ? &top->rhs : nullptr);
+		if (top) {
+			std::fill(top->field.cells.begin(), top->field.cells.end(), 0.0);
+			m_agglomerated->cycle(0);
+		}
+		// the residual isn't needed any more, so the correction comes back into it
+		MPI_Scatterv(top ? top->field.row(0) : nullptr, m_counts.data(), m_displacements.data(), m_row_type, level.residual.row(0), 1, m_block_type, 0, m_grid.comm);
+		m_agglomerated_time += agglomerated_timer.stop().count();
+
+		for_each_row(level, [&](int i) {
+			const double* correction = level.residual.row(i);
+			double* field = level.field.row(i);
+			for (int j = 0; j < level.columns(); j++) field[j] += correction[j];
+		});
+	}
+
+	const ProcessGrid& m_grid;
+	vector<Level> m_levels;
+
+	// the coarsest split level's rows, in place in a tile of one process and of the whole level
+	bool m_agglomerating = false;
+	MPI_Datatype m_block_type;
+	MPI_Datatype m_row_type;
+	vector<int> m_counts;
+	vector<int> m_displacements;
+	// the levels below the split ones, on process 0
+	ProcessGrid m_self;
+	std::unique_ptr<Multigrid> m_agglomerated;
+
+	double m_initial_norm = 0;
+	double m_final_norm = 0;
+	double m_halo_time = 0;
+	double m_reduce_time = 0;
+	double m_agglomerated_time = 0;
+};
+
+int run_steady_state(const HeatProblem& problem, const ResidentOptions& options, FrameWriter* frames) {
+	int world_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+	int world_size;
+	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+	if (problem.rows < world_size) {
+		if (world_rank == 0) std::cerr << "Error: can't split " << problem.rows << " rows between " << world_size << " processes.\n";
+		return 1;
+	}
+
+	int dims[2] = { world_size, 1 };
+	ProcessGrid grid = create_process_grid(dims);
+	int rank = grid.rank;
+	int columns = problem.columns;
+	BlockRange block_rows = block_range(problem.rows, world_size, grid.coords[0]);
+	BlockRange block_columns{ 0, columns };
+
+	// 1 for the cells being solved for, 0 for the sources
+	Tile free(block_rows, block_columns, 1);
+	std::fill(free.cells.begin(), free.cells.end(), 1.0);
+	for (const HeatSource& source : HEAT_SOURCES) {
+		if (!problem.contains(source.row, source.column)) continue;
+		int i = source.row - block_rows.start;
+		if (i >= 0 && i < block_rows.count) free.row(i)[source.column] = 0.0;
+	}
+
+	{
+		Timer setup_timer;
+		Multigrid multigrid(grid, free, problem.boundary);
+		double setup_time = setup_timer.stop().count();
+		if (rank == 0) std::cout << "Multigrid levels: " << multigrid.levels() << "." << std::endl;
+
+		// starting from a cold grid with the sources in it
+		Tile field(block_rows, block_columns, 1);
+		set_sources(problem, field);
+
+		Timer solve_timer;
+		int iterations = multigrid.solve(field, options.solver_tolerance, options.max_iterations);
+		double solve_time = solve_timer.stop().count();
+
+		if (options.output_interval > 0) {
+			vector<double> whole((rank == 0) ? (size_t)problem.rows * columns : 0);
+			FieldGather field_gather(grid, field, problem.rows, columns);
+			field_gather.gather(field, whole);
+			if (rank == 0) frames->write(whole.data());
+		}
+
+		double local_sum = 0;
+		for (int i = 0; i < field.rows.count; i++) {
+			for (int j = 0; j < columns; j++) local_sum += field.row(i)[j];
+		}
+		double checksum;
+		MPI_Reduce(&local_sum, &checksum, 1, MPI_DOUBLE, MPI_SUM, 0, grid.comm);
+		uint64_t local_fingerprint = field_fingerprint(field.row(0), field.rows, field.columns, columns, field.stride);
+		uint64_t fingerprint;
+		MPI_Reduce(&local_fingerprint, &fingerprint, 1, MPI_UINT64_T, MPI_SUM, 0, grid.comm);
+
+		double local_times[3] = { multigrid.halo_time(), multigrid.reduce_time(), multigrid.agglomerated_time() };
+		double max_times[3];
+		MPI_Reduce(local_times, max_times, 3, MPI_DOUBLE, MPI_MAX, 0, grid.comm);
+
+		if (rank == 0) {
+			std::cout << "Field checksum: " << std::setprecision(15) << checksum << std::setprecision(6) << ", fingerprint " << std::hex << fingerprint << std::dec << std::endl;
+			if (multigrid.final_norm() > options.solver_tolerance * multigrid.initial_norm()) {
+				std::cout << "Warning: the residual only dropped to " << multigrid.final_norm() / multigrid.initial_norm() << " of where it started in "
+					<< iterations << " iterations." << std::endl;
+			}
+			else if (iterations > 0) {
+				std::cout << "Converged in " << iterations << " iterations of conjugate gradients with a V-cycle each, the residual dropping by a factor of "
+					<< std::pow(multigrid.initial_norm() / multigrid.final_norm(), 1.0 / iterations) << " per iteration." << std::endl;
+			}
+			std::cout << "Setting up the levels took " << setup_time << " seconds, solving " << solve_time << ", "
+				<< solve_time / std::max(1, iterations) / ((double)problem.rows * columns) * 1e9 << " ns per cell per iteration." << std::endl;
+			std::cout << "Slowest process spent " << max_times[0] << " seconds exchanging ghost cells, " << max_times[1] << " in allreduces and "
+				<< max_times[2] << " on the agglomerated levels." << std::endl;
+		}
+	}
+
+	MPI_Comm_free(&grid.comm);
+	return 0;
+}
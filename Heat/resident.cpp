@@ -0,0 +1,661 @@
+#include "checkpoint.h"
+#include "frames.h"
+#include "heat.h"
+#include "resident.h"
+#include "stencil.h"
+
+#include <mpi.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using std::vector;
+
+// checks in a row the change has to stay below the tolerance for before a run ends early
+constexpr int QUIET_CHECKS = 2;
+
+struct ResidentStats {
+	double compute_time = 0;
+	double halo_time = 0; // the whole exchange, or with persistent requests just waiting for it
+	double gather_time = 0;
+	double check_time = 0; // measuring the change and waiting for its allreduce
+};
+
+bool choose_process_grid(int rows, int columns, int processes, int dims[2]) {
+	double best = -1;
+	for (int process_rows = processes; process_rows >= 1; process_rows--) {
+		if (processes % process_rows != 0) continue;
+		int process_columns = processes / process_rows;
+		if (process_rows > rows || process_columns > columns) continue;
+
+		// the halo of a block in the middle of the grid, in cells
+		double edges = 2.0 * ((rows + process_rows - 1) / process_rows) * (process_columns > 1) + 2.0 * ((columns + process_columns - 1) / process_columns) * (process_rows > 1);
+		if (best < 0 || edges < best) {
+			best = edges;
+			dims[0] = process_rows;
+			dims[1] = process_columns;
+		}
+	}
+	return best >= 0;
+}
+
+ProcessGrid create_process_grid(const int dims[2]) {
+	ProcessGrid grid;
+	grid.dims[0] = dims[0];
+	grid.dims[1] = dims[1];
+	// no reordering, so rank 0 of the grid is still the world rank 0 that writes the frames
+	int periods[2] = { 0, 0 };
+	MPI_Cart_create(MPI_COMM_WORLD, 2, grid.dims, periods, 0, &grid.comm);
+	MPI_Comm_rank(grid.comm, &grid.rank);
+	MPI_Comm_size(grid.comm, &grid.size);
+	MPI_Cart_coords(grid.comm, grid.rank, 2, grid.coords);
+	MPI_Cart_shift(grid.comm, 0, 1, &grid.up, &grid.down);
+	MPI_Cart_shift(grid.comm, 1, 1, &grid.left, &grid.right);
+	return grid;
+}
+
+/**
+* The ghost border exchange of one tile as persistent requests, set up once and restarted every step.
+*/
+class PersistentHalo {
+public:
+	PersistentHalo(const HaloMessages& messages, Tile& tile, MPI_Comm comm) {
+		messages.for_each(tile, [&](double* buffer, MPI_Datatype type, int neighbour, int tag, bool is_send) {
+			m_requests.emplace_back();
+			if (is_send) MPI_Send_init(buffer, 1, type, neighbour, tag, comm, &m_requests.back());
+			else MPI_Recv_init(buffer, 1, type, neighbour, tag, comm, &m_requests.back());
+		});
+	}
+
+	PersistentHalo(const PersistentHalo&) = delete;
+	PersistentHalo& operator=(const PersistentHalo&) = delete;
+
+	~PersistentHalo() {
+		for (MPI_Request& request : m_requests) MPI_Request_free(&request);
+	}
+
+	void start() {
+		MPI_Startall((int)m_requests.size(), m_requests.data());
+	}
+
+	void wait() {
+		MPI_Waitall((int)m_requests.size(), m_requests.data(), MPI_STATUSES_IGNORE);
+	}
+
+private:
+	vector<MPI_Request> m_requests;
+};
+
+void fill_boundary(Tile& tile, const ProcessGrid& grid, BoundaryCondition boundary, int reach) {
+	Stencil::Edges edges{ grid.up == MPI_PROC_NULL, grid.down == MPI_PROC_NULL, grid.left == MPI_PROC_NULL, grid.right == MPI_PROC_NULL };
+	Stencil::fill_boundary(boundary, tile.row(0), tile.stride, tile.rows.count, tile.columns.count, edges, reach);
+}
+
+void set_sources(const HeatProblem& problem, Tile& tile) {
+	BlockRange rows{ tile.rows.start - tile.halo, tile.rows.count + 2 * tile.halo };
+	BlockRange columns{ tile.columns.start - tile.halo, tile.columns.count + 2 * tile.halo };
+	apply_sources(problem, tile.cells.data(), rows, columns, tile.stride);
+}
+
+/**
+* One step for the cells in rows first_row ... last_row - 1 and columns first_column ... last_column - 1 of the tile.
+* The neighbours all come from the ghost border, which makes this the same arithmetic as heat_sim's scatter/gather loop.
+*/
+void update_cells(const Tile& in, Tile& out, int first_row, int last_row, int first_column, int last_column, double coefficient) {
+	Stencil::update(in.row(0), out.row(0), in.stride, first_row, last_row, first_column, last_column, coefficient);
+}
+
+/**
+* The largest change of any of the block's own cells between two states of the tile.
+*/
+static double max_change(const Tile& now, const Tile& before) {
+	double change = 0;
+	for (int i = 0; i < now.rows.count; i++) {
+		const double* a = now.row(i);
+		const double* b = before.row(i);
+		for (int j = 0; j < now.columns.count; j++) change = std::max(change, std::abs(a[j] - b[j]));
+	}
+	return change;
+}
+
+/**
+* Implicit steps: (I - theta r L) next = (I + (1 - theta) r L) current, where L is the five point Laplacian with the boundary condition
+* in its ghost cells and r the coefficient. theta = 1/2 is Crank-Nicolson and theta = 1 backward Euler, and neither has a limit on the step.
+* The matrix is symmetric positive definite, so it is solved with conjugate gradients without ever being built: applying it is one ghost cell exchange
+* and a stencil, and each iteration needs two allreduces for its dot products.
+* The sources are left out of the system, holding them fixed, and their temperature ends up on the right hand side through their neighbours.
+*/
+class ImplicitSolver {
+public:
+	ImplicitSolver(const HeatProblem& problem, const ProcessGrid& grid, const HaloMessages& messages, const Tile& shape, double theta, double tolerance, int max_iterations)
+		: m_problem(problem), m_grid(grid), m_messages(messages), m_theta(theta), m_tolerance(tolerance), m_max_iterations(max_iterations),
+		m_rhs(shape), m_residual(shape), m_direction(shape), m_product(shape), m_free(shape), m_coupling(shape) {
+		// 1 for the cells being solved for, 0 for the sources
+		std::fill(m_free.cells.begin(), m_free.cells.end(), 1.0);
+		for (const HeatSource& source : HEAT_SOURCES) {
+			if (!problem.contains(source.row, source.column)) continue;
+			int i = source.row - shape.rows.start;
+			int j = source.column - shape.columns.start;
+			if (i >= 0 && i < shape.rows.count && j >= 0 && j < shape.columns.count) m_free.row(i)[j] = 0.0;
+		}
+
+		// what the sources take off the right hand side through their neighbours, the same every step
+		Tile sources = shape;
+		std::fill(sources.cells.begin(), sources.cells.end(), 0.0);
+		set_sources(problem, sources);
+		apply(sources, m_coupling, -theta * problem.coefficient());
+	}
+
+	/**
+	* Takes one step from current into next.
+	* @return false if it didn't converge within the maximum number of iterations.
+	*/
+	bool step(Tile& current, Tile& next) {
+		double r = m_problem.coefficient();
+		int columns = m_free.columns.count;
+		apply(current, m_rhs, (1 - m_theta) * r);
+
+		// starting from where the field is now
+		next.cells = current.cells;
+		apply(next, m_product, -m_theta * r);
+		for_each_row([&](int i) {
+			const double* rhs = m_rhs.row(i);
+			const double* product = m_product.row(i);
+			double* residual = m_residual.row(i);
+			double* direction = m_direction.row(i);
+			for (int j = 0; j < columns; j++) {
+				residual[j] = rhs[j] - product[j];
+				direction[j] = residual[j];
+			}
+		});
+
+		// measured against the whole right hand side, sources included, since m_rhs alone is 0 for backward Euler from a cold field
+		double local_target = 0;
+		for_each_row([&](int i) {
+			const double* rhs = m_rhs.row(i);
+			const double* coupling = m_coupling.row(i);
+			for (int j = 0; j < columns; j++) local_target += (rhs[j] - coupling[j]) * (rhs[j] - coupling[j]);
+		});
+		double target = m_tolerance * m_tolerance * sum(local_target);
+		double residual_norm = dot(m_residual, m_residual);
+		int iteration = 0;
+		for (; residual_norm > target && iteration < m_max_iterations; iteration++) {
+			apply(m_direction, m_product, -m_theta * r);
+			double alpha = residual_norm / dot(m_direction, m_product);
+
+			double local_norm = 0;
+			for_each_row([&](int i) {
+				const double* direction = m_direction.row(i);
+				const double* product = m_product.row(i);
+				double* field = next.row(i);
+				double* residual = m_residual.row(i);
+				for (int j = 0; j < columns; j++) {
+					field[j] += alpha * direction[j];
+					residual[j] -= alpha * product[j];
+				}
+				local_norm += row_dot(residual, residual, columns);
+			});
+
+			double new_norm = sum(local_norm);
+			double beta = new_norm / residual_norm;
+			residual_norm = new_norm;
+			for_each_row([&](int i) {
+				const double* residual = m_residual.row(i);
+				double* direction = m_direction.row(i);
+				for (int j = 0; j < columns; j++) direction[j] = residual[j] + beta * direction[j];
+			});
+		}
+
+		// the same bounds as the explicit steps
+		for_each_row([&](int i) {
+			double* field = next.row(i);
+			for (int j = 0; j < columns; j++) field[j] = std::clamp(field[j], 0.0, MAX_TEMP);
+		});
+
+		m_iterations += iteration;
+		m_steps++;
+		return residual_norm <= target;
+	}
+
+	long long iterations() const { return m_iterations; }
+	int steps() const { return m_steps; }
+	double halo_time() const { return m_halo_time; }
+	double reduce_time() const { return m_reduce_time; }
+
+private:
+	template <typename F> void for_each_row(F&& body) {
+		for (int i = 0; i < m_free.rows.count; i++) body(i);
+	}
+
+	/**
+	* out = in + factor * L in, and 0 for the sources.
+	*/
+	void apply(Tile& in, Tile& out, double factor) {
+		Timer halo_timer;
+		m_messages.exchange(in);
+		fill_boundary(in, m_grid, m_problem.boundary, 0);
+		m_halo_time += halo_timer.stop().count();
+
+		ThreadPool::instance().parallel_for(0, in.rows.count, [&](long long first_row, long long end_row) {
+			for (int i = (int)first_row; i < end_row; i++) {
+				const double* up = in.row(i - 1);
+				const double* here = in.row(i);
+				const double* down = in.row(i + 1);
+				const double* is_free = m_free.row(i);
+				double* result = out.row(i);
+				for (int j = 0; j < in.columns.count; j++) {
+					double laplacian = here[j - 1] + here[j + 1] + up[j] + down[j] - 4 * here[j];
+					result[j] = is_free[j] * (here[j] + factor * laplacian);
+				}
+			}
+		});
+	}
+
+	/**
+	* Spread over a few partial sums, so the additions don't all wait for the one before and the loop vectorizes.
+	*/
+	static double row_dot(const double* x, const double* y, int count) {
+		constexpr int LANES = 8;
+		double partial[LANES] = {};
+		int j = 0;
+		for (; j + LANES <= count; j += LANES) {
+			for (int lane = 0; lane < LANES; lane++) partial[lane] += x[j + lane] * y[j + lane];
+		}
+		for (; j < count; j++) partial[0] += x[j] * y[j];
+
+		double total = 0;
+		for (int lane = 0; lane < LANES; lane++) total += partial[lane];
+		return total;
+	}
+
+	double dot(const Tile& a, const Tile& b) {
+		double local = 0;
+		for (int i = 0; i < a.rows.count; i++) local += row_dot(a.row(i), b.row(i), a.columns.count);
+		return sum(local);
+	}
+
+	double sum(double local) {
+		Timer reduce_timer;
+		double total;
+		MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, m_grid.comm);
+		m_reduce_time += reduce_timer.stop().count();
+		return total;
+	}
+
+	const HeatProblem& m_problem;
+	const ProcessGrid& m_grid;
+	const HaloMessages& m_messages;
+	double m_theta;
+	double m_tolerance;
+	int m_max_iterations;
+
+	Tile m_rhs;
+	Tile m_residual;
+	Tile m_direction;
+	Tile m_product;
+	Tile m_free;
+	Tile m_coupling; // the product of the matrix and just the sources
+
+	long long m_iterations = 0;
+	int m_steps = 0;
+	double m_halo_time = 0;
+	double m_reduce_time = 0;
+};
+
+/**
+* The most steps that can be taken per exchange: the ghost border can't be deeper than the smallest block it comes from.
+*/
+int max_time_block(const HeatProblem& problem, const int dims[2]) {
+	if (dims[0] == 1 && dims[1] == 1) return 1; // nothing to exchange
+	int depth = INT_MAX;
+	if (dims[0] > 1) depth = std::min(depth, problem.rows / dims[0]);
+	if (dims[1] > 1) depth = std::min(depth, problem.columns / dims[1]);
+	return depth;
+}
+
+// exchanges and steps timed to pick the number of steps per exchange
+constexpr int TUNING_EXCHANGES = 20;
+constexpr int TUNING_STEPS = 3;
+
+/**
+* Picks how many steps to take per exchange. Taking k of them pays the latency of an exchange once instead of k times,
+* but the ghost border has to be k deep, and a shrinking part of it is updated on both sides, about (k - 1) / 2 extra layers
+* along every exchanged edge per step. latency / k + (k - 1) / 2 * (cost of a layer) is smallest at k = sqrt(2 * latency / cost of a layer).
+* Both are measured on a throwaway tile, and the slowest process's numbers are used so every process picks the same k.
+*/
+int tune_time_block(const HeatProblem& problem, const ProcessGrid& grid, BlockRange rows, BlockRange columns, int max_depth) {
+	Tile probe(rows, columns, 1);
+	Tile probe_next = probe;
+	HaloMessages messages(grid, rows.count, columns.count, probe.stride, 1);
+	double coefficient = problem.coefficient();
+
+	messages.exchange(probe);
+	MPI_Barrier(grid.comm);
+	Timer exchange_timer;
+	for (int i = 0; i < TUNING_EXCHANGES; i++) messages.exchange(probe);
+	double latency = exchange_timer.stop().count() / TUNING_EXCHANGES;
+
+	Timer step_timer;
+	for (int i = 0; i < TUNING_STEPS; i++) {
+		ThreadPool::instance().parallel_for(0, rows.count, [&](long long first_row, long long end_row) {
+			update_cells(probe, probe_next, (int)first_row, (int)end_row, 0, columns.count, coefficient);
+		});
+	}
+	double cell_time = step_timer.stop().count() / TUNING_STEPS / ((double)rows.count * columns.count);
+
+	int edge_cells = (grid.up != MPI_PROC_NULL) * columns.count + (grid.down != MPI_PROC_NULL) * columns.count
+		+ (grid.left != MPI_PROC_NULL) * rows.count + (grid.right != MPI_PROC_NULL) * rows.count;
+	double local[2] = { latency, cell_time * edge_cells };
+	double slowest[2];
+	MPI_Allreduce(local, slowest, 2, MPI_DOUBLE, MPI_MAX, grid.comm);
+
+	double best = (slowest[1] > 0) ? std::sqrt(2 * slowest[0] / slowest[1]) : 1.0;
+	int depth = (int)std::lround(std::clamp(best, 1.0, (double)max_depth));
+	if (grid.rank == 0) {
+		std::cout << "Measured " << slowest[0] * 1e6 << " us per exchange and " << slowest[1] * 1e6 << " us per layer of edge cells, "
+			<< "taking " << depth << " steps per exchange." << std::endl;
+	}
+	return depth;
+}
+
+int run_resident(const HeatProblem& problem, const ResidentOptions& options, FrameWriter* frames) {
+	int world_rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+	int world_size;
+	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+	int dims[2] = { world_size, 1 };
+	bool fits = problem.rows >= world_size;
+	if (options.decomposition == Decomposition::Blocks) {
+		if (options.process_rows > 0 && options.process_columns > 0) {
+			dims[0] = options.process_rows;
+			dims[1] = options.process_columns;
+			fits = dims[0] * dims[1] == world_size && dims[0] <= problem.rows && dims[1] <= problem.columns;
+		}
+		else {
+			fits = choose_process_grid(problem.rows, problem.columns, world_size, dims);
+		}
+	}
+	if (!fits) {
+		if (world_rank == 0) std::cerr << "Error: can't split a " << problem.rows << " x " << problem.columns << " grid into " << dims[0] << " x " << dims[1] << " blocks of at least one cell for " << world_size << " processes.\n";
+		return 1;
+	}
+
+	if (options.persistent_halo && options.time_block != 1) {
+		if (world_rank == 0) std::cerr << "Error: --time-block only works with --halo=blocking.\n";
+		return 1;
+	}
+	bool implicit = options.integrator != Integrator::Explicit;
+	if (implicit && (options.persistent_halo || options.time_block != 1)) {
+		if (world_rank == 0) std::cerr << "Error: --implicit only works with --halo=blocking and one step per exchange.\n";
+		return 1;
+	}
+
+	if (options.steady_tolerance > 0 && options.check_interval < 1) {
+		if (world_rank == 0) std::cerr << "Error: --check-interval has to be at least 1.\n";
+		return 1;
+	}
+
+	ProcessGrid grid = create_process_grid(dims);
+	int rank = grid.rank;
+	int columns = problem.columns;
+	BlockRange block_rows = block_range(problem.rows, dims[0], grid.coords[0]);
+	BlockRange block_columns = block_range(columns, dims[1], grid.coords[1]);
+
+	int max_depth = max_time_block(problem, dims);
+	int time_block = options.time_block;
+	if (time_block == 0) time_block = tune_time_block(problem, grid, block_rows, block_columns, max_depth);
+	if (time_block > max_depth) {
+		if (rank == 0) std::cout << "Blocks are too small for " << time_block << " steps per exchange, taking " << max_depth << "." << std::endl;
+		time_block = max_depth;
+	}
+
+	// the ghost border is as deep as the number of steps taken per exchange
+	Tile current(block_rows, block_columns, time_block);
+	Tile next = current;
+	int tile_rows = current.rows.count;
+	int tile_columns = current.columns.count;
+
+	// a restarted run reads its blocks straight out of the checkpoint, whatever the blocks were when it was written
+	int first_step = 0;
+	CheckpointHeader restart{};
+	if (!options.restart_path.empty()) {
+		if (!read_checkpoint_header(options.restart_path, restart, grid.comm) || !read_checkpoint(options.restart_path, restart, block_rows, block_columns, current.row(0), current.stride, grid.comm)) {
+			if (rank == 0) std::cerr << "Error: can't restart from " << options.restart_path << ".\n";
+			MPI_Comm_free(&grid.comm);
+			return 1;
+		}
+		first_step = (int)restart.step;
+	}
+
+	std::unique_ptr<Checkpointer> checkpointer;
+	if (options.checkpoint_interval > 0) {
+		// carrying on in the file the run restarted from, the checkpoint it restarted from stays until there is a newer one
+		bool same_file = options.checkpoint_path == options.restart_path;
+		int first_slot = same_file ? 1 - (int)restart.slot : 0;
+		checkpointer = std::make_unique<Checkpointer>(options.checkpoint_path, problem, block_rows, block_columns, same_file, first_slot, grid.comm);
+	}
+
+	vector<double> field((rank == 0) ? (size_t)problem.rows * columns : 0);
+	bool gathering = options.output_interval > 0;
+	double coefficient = problem.coefficient();
+	ResidentStats stats;
+
+	HaloMessages messages(grid, tile_rows, tile_columns, current.stride, current.halo);
+	FieldGather field_gather(grid, current, problem.rows, columns);
+
+	// the requests point at the buffers, and current and next swap buffers every step, so there is a set for each and they take turns
+	std::unique_ptr<PersistentHalo> halos[2];
+	if (options.persistent_halo) {
+		halos[0] = std::make_unique<PersistentHalo>(messages, current, grid.comm);
+		halos[1] = std::make_unique<PersistentHalo>(messages, next, grid.comm);
+	}
+
+	std::unique_ptr<ImplicitSolver> solver;
+	if (implicit) {
+		double theta = (options.integrator == Integrator::CrankNicolson) ? 0.5 : 1.0;
+		solver = std::make_unique<ImplicitSolver>(problem, grid, messages, current, theta, options.solver_tolerance, options.max_iterations);
+	}
+	int unconverged_steps = 0;
+
+	// the change is measured every check_interval steps, and its allreduce goes on behind the steps up to the next check,
+	// where it is waited for, so every process sees the same result at the same step and they all stop together
+	bool checking = options.steady_tolerance > 0;
+	MPI_Request change_request = MPI_REQUEST_NULL;
+	double local_change = 0;
+	double global_change = 0;
+	int checked_step = 0; // the step the change in flight was measured after
+	int quiet_checks = 0;
+	int quiet_step = 0; // the first step of the last run of quiet checks
+	int last_step = problem.num_steps;
+
+	if (rank == 0) {
+		if (implicit) std::cout << ((options.integrator == Integrator::CrankNicolson) ? "Crank-Nicolson" : "Backward Euler") << " steps, solved with conjugate gradients to a tolerance of " << options.solver_tolerance << "." << std::endl;
+		std::cout << "Process grid: " << dims[0] << " x " << dims[1] << ", blocks of about " << problem.rows / dims[0] << " x " << columns / dims[1] << " cells." << std::endl;
+		if (options.persistent_halo) std::cout << "Ghost cells are exchanged with persistent requests, overlapped with the interior of the blocks." << std::endl;
+		if (time_block > 1) std::cout << "Ghost borders are " << time_block << " cells deep, exchanged every " << time_block << " steps." << std::endl;
+		std::cout << "Each process keeps its block for the whole run, ";
+		if (gathering) std::cout << "the field is gathered every " << options.output_interval << " steps." << std::endl;
+		else std::cout << "the field is never gathered." << std::endl;
+		if (first_step > 0) std::cout << "Restarted from " << options.restart_path << " after step " << first_step << "." << std::endl;
+		if (checkpointer) std::cout << "Checkpoints go to " << options.checkpoint_path << " every " << options.checkpoint_interval << " steps." << std::endl;
+		if (checking) std::cout << "Stopping once the largest change in a step stays below " << options.steady_tolerance << ", checked every " << options.check_interval << " steps." << std::endl;
+	}
+
+	if (gathering) {
+		field_gather.gather(current, field);
+		if (rank == 0) frames->write(field.data());
+	}
+
+	Timer steps_timer;
+	for (int step = first_step; step < problem.num_steps; step++) {
+		if (step % std::max(1, problem.num_steps / 10) == 0) {
+			if (rank == 0) std::cout << "Approximately " << (double)step / problem.num_steps * 100 << "% done." << std::endl;
+		}
+
+		set_sources(problem, current);
+
+		if (solver) {
+			Timer compute_timer;
+			if (!solver->step(current, next)) unconverged_steps++;
+			stats.compute_time += compute_timer.stop().count();
+		}
+		else if (options.persistent_halo) {
+			// the halos are in flight while the cells that don't need them are updated
+			Timer compute_timer;
+			PersistentHalo& halo = ((step - first_step) % 2 == 0) ? *halos[0] : *halos[1];
+			halo.start();
+			fill_boundary(current, grid, problem.boundary, 0);
+			ThreadPool::instance().parallel_for(1, tile_rows - 1, [&](long long first_row, long long end_row) {
+				update_cells(current, next, (int)first_row, (int)end_row, 1, tile_columns - 1, coefficient);
+			});
+			double interior_time = compute_timer.stop().count();
+
+			Timer halo_timer;
+			halo.wait();
+			stats.halo_time += halo_timer.stop().count();
+
+			// then the ring of cells along the edges of the block
+			Timer edge_timer;
+			update_cells(current, next, 0, 1, 0, tile_columns, coefficient);
+			if (tile_rows > 1) update_cells(current, next, tile_rows - 1, tile_rows, 0, tile_columns, coefficient);
+			update_cells(current, next, 1, tile_rows - 1, 0, 1, coefficient);
+			if (tile_columns > 1) update_cells(current, next, 1, tile_rows - 1, tile_columns - 1, tile_columns, coefficient);
+			stats.compute_time += interior_time + edge_timer.stop().count();
+		}
+		else {
+			// how far into the ghost border this step reaches: after an exchange the border is valid time_block cells deep,
+			// and each step leaves one less of it valid, so it is updated one cell less deep every step until the next exchange
+			int block_step = (step - first_step) % time_block;
+			int reach = std::min(time_block - 1 - block_step, problem.num_steps - step - 1);
+
+			Timer halo_timer;
+			if (block_step == 0) messages.exchange(current);
+			fill_boundary(current, grid, problem.boundary, reach);
+			stats.halo_time += halo_timer.stop().count();
+
+			int first_row = (grid.up != MPI_PROC_NULL) ? -reach : 0;
+			int last_row = tile_rows + ((grid.down != MPI_PROC_NULL) ? reach : 0);
+			int first_column = (grid.left != MPI_PROC_NULL) ? -reach : 0;
+			int last_column = tile_columns + ((grid.right != MPI_PROC_NULL) ? reach : 0);
+
+			Timer compute_timer;
+			ThreadPool::instance().parallel_for(first_row, last_row, [&](long long first, long long end) {
+				update_cells(current, next, (int)first, (int)end, first_column, last_column, coefficient);
+			});
+			stats.compute_time += compute_timer.stop().count();
+		}
+
+		std::swap(current, next);
+		set_sources(problem, current);
+
+		if (gathering && (step + 1) % options.output_interval == 0) {
+			Timer gather_timer;
+			field_gather.gather(current, field);
+			if (rank == 0) frames->write(field.data());
+			stats.gather_time += gather_timer.stop().count();
+		}
+
+		if (checkpointer) {
+			// each checkpoint is written behind the next half interval of steps, then the header is pointed at it
+			int steps_done = step + 1;
+			if (steps_done % options.checkpoint_interval == 0) checkpointer->start(current.row(0), current.stride, steps_done);
+			else if (steps_done % options.checkpoint_interval == std::max(1, options.checkpoint_interval / 2)) checkpointer->finish();
+		}
+
+		if (checking && (step + 1 - first_step) % options.check_interval == 0) {
+			Timer check_timer;
+			if (change_request != MPI_REQUEST_NULL) {
+				MPI_Wait(&change_request, MPI_STATUS_IGNORE);
+				if (global_change >= options.steady_tolerance) quiet_checks = 0;
+				else if (quiet_checks++ == 0) quiet_step = checked_step;
+			}
+			if (quiet_checks == QUIET_CHECKS) {
+				stats.check_time += check_timer.stop().count();
+				last_step = step + 1;
+				break;
+			}
+
+			local_change = max_change(current, next);
+			MPI_Iallreduce(&local_change, &global_change, 1, MPI_DOUBLE, MPI_MAX, grid.comm, &change_request);
+			checked_step = step + 1;
+			stats.check_time += check_timer.stop().count();
+		}
+	}
+	if (change_request != MPI_REQUEST_NULL) MPI_Wait(&change_request, MPI_STATUS_IGNORE);
+	if (checkpointer) checkpointer->finish();
+	double steps_time = steps_timer.stop().count();
+	int steps_taken = last_step - first_step;
+
+	double local_sum = 0;
+	for (int i = 0; i < tile_rows; i++) {
+		for (int j = 0; j < tile_columns; j++) local_sum += current.row(i)[j];
+	}
+	double checksum;
+	MPI_Reduce(&local_sum, &checksum, 1, MPI_DOUBLE, MPI_SUM, 0, grid.comm);
+	uint64_t local_fingerprint = field_fingerprint(current.row(0), current.rows, current.columns, columns, current.stride);
+	uint64_t fingerprint;
+	MPI_Reduce(&local_fingerprint, &fingerprint, 1, MPI_UINT64_T, MPI_SUM, 0, grid.comm);
+
+	if (solver) {
+		// the solver's exchanges were timed as part of computing, they are counted with the others instead
+		stats.compute_time -= solver->halo_time();
+		stats.halo_time += solver->halo_time();
+	}
+
+	double local_times[4] = { stats.compute_time, stats.halo_time, stats.gather_time, stats.check_time };
+	double max_times[4];
+	MPI_Reduce(local_times, max_times, 4, MPI_DOUBLE, MPI_MAX, 0, grid.comm);
+	double mean_halo_time;
+	MPI_Reduce(&stats.halo_time, &mean_halo_time, 1, MPI_DOUBLE, MPI_SUM, 0, grid.comm);
+	mean_halo_time /= world_size;
+
+	if (rank == 0) {
+		std::cout << "Field checksum: " << std::setprecision(15) << checksum << std::setprecision(6) << ", fingerprint " << std::hex << fingerprint << std::dec << std::endl;
+		std::cout << "Slowest process spent " << max_times[0] << " seconds computing, " << max_times[1] << " exchanging ghost cells and "
+			<< max_times[2] << " gathering the field." << std::endl;
+		int steps = std::max(1, steps_taken);
+		std::cout << ((options.persistent_halo) ? "Waiting for ghost cells" : "Exchanging ghost cells") << " took " << mean_halo_time / steps * 1e6
+			<< " us per step on average, " << max_times[1] / steps * 1e6 << " on the slowest process." << std::endl;
+		double updates = (double)problem.rows * columns * steps_taken;
+		if (solver) {
+			std::cout << "Conjugate gradients took " << (double)solver->iterations() / std::max(1, solver->steps()) << " iterations per step on average, "
+				<< solver->reduce_time() << " seconds in allreduces on process 0." << std::endl;
+			if (unconverged_steps > 0) std::cout << "Warning: " << unconverged_steps << " steps didn't converge within " << options.max_iterations << " iterations." << std::endl;
+		}
+		else std::cout << "Stencil kernel (" << Stencil::SIMD_NAME << "): " << updates / max_times[0] / 1e6 << " million cell updates per second over the slowest process's compute time." << std::endl;
+		if (checking) {
+			if (last_step < problem.num_steps) {
+				// the steps that were skipped would have taken as long as the average one that was taken
+				int skipped = problem.num_steps - last_step;
+				std::cout << "Reached a steady state: the largest change in a step stayed below " << options.steady_tolerance << " from step " << quiet_step
+					<< ", the run stopped after step " << last_step << " of " << problem.num_steps << ". Skipping the other " << skipped << " steps saved about "
+					<< steps_time / steps * skipped << " seconds." << std::endl;
+			}
+			else if (checked_step > 0) std::cout << "Didn't reach a steady state, the largest change in the last step checked was " << global_change << "." << std::endl;
+			else std::cout << "Didn't reach a steady state, the run was shorter than " << options.check_interval << " steps." << std::endl;
+			std::cout << "Checking for it took " << max_times[3] << " seconds on the slowest process." << std::endl;
+		}
+	}
+
+	if (checkpointer) {
+		double local_checkpoint_times[2] = { checkpointer->start_time(), checkpointer->finish_time() };
+		double max_checkpoint_times[2];
+		MPI_Reduce(local_checkpoint_times, max_checkpoint_times, 2, MPI_DOUBLE, MPI_MAX, 0, grid.comm);
+		int count = checkpointer->checkpoints();
+		if (rank == 0 && count > 0) {
+			std::cout << "Wrote " << count << " checkpoints of " << checkpointer->field_bytes() / 1e6 << " MB. Per checkpoint, the slowest process spent "
+				<< max_checkpoint_times[0] / count << " seconds starting it and " << max_checkpoint_times[1] / count << " finishing it, "
+				<< (max_checkpoint_times[0] + max_checkpoint_times[1]) / steps_time * 100 << "% of the time the steps took." << std::endl;
+		}
+	}
+
+	checkpointer.reset();
+	halos[0].reset();
+	halos[1].reset();
+	MPI_Comm_free(&grid.comm);
+	return 0;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "heat.h"
+
+#include <mpi.h>
+#include <vector>
+
+// the pieces resident mode is built from, shared with the steady state solver
+
+/**
+* The block of the grid one rank owns for the whole run, with a border of ghost cells around it.
+* With the row decomposition the blocks are full rows, and the ghost columns just hold the boundary condition.
+*/
+struct Tile {
+	BlockRange rows; // of the whole grid
+	BlockRange columns;
+	int halo; // depth of the ghost border
+	int stride;
+	std::vector<double> cells; // (rows.count + 2 * halo) × stride
+
+	Tile(BlockRange rows, BlockRange columns, int halo)
+		: rows(rows), columns(columns), halo(halo), stride(columns.count + 2 * halo), cells((size_t)(rows.count + 2 * halo) * stride, 0.0) {}
+
+	/**
+	* @return Row i of the tile, starting at its first owned column. Ghost cells are at negative indices and past the end.
+	*/
+	double* row(int i) {
+		return cells.data() + (size_t)(i + halo) * stride + halo;
+	}
+
+	const double* row(int i) const {
+		return cells.data() + (size_t)(i + halo) * stride + halo;
+	}
+};
+
+/**
+* The ranks of the Cartesian communicator and the neighbours of this one, MPI_PROC_NULL at the edges of the grid.
+*/
+struct ProcessGrid {
+	MPI_Comm comm;
+	int rank;
+	int size;
+	int dims[2]; // process rows, process columns
+	int coords[2];
+	int up;
+	int down;
+	int left;
+	int right;
+};
+
+// message tags, by the direction the data travels in
+constexpr int TAG_UP = 0;
+constexpr int TAG_DOWN = 1;
+constexpr int TAG_LEFT = 2;
+constexpr int TAG_RIGHT = 3;
+
+/**
+* Arranges MPI_COMM_WORLD into a dims[0] × dims[1] Cartesian grid, without wraparound or reordering, so ranks in it are world ranks.
+*/
+ProcessGrid create_process_grid(const int dims[2]);
+
+/**
+* Picks the process grid whose blocks have the shortest edges, and so the fewest ghost cells to exchange per cell owned.
+* Ties go to more process rows, whose halos are contiguous.
+* @return false if the grid is too small to give every process at least one cell.
+*/
+bool choose_process_grid(int rows, int columns, int processes, int dims[2]);
+
+/**
+* The sends and receives that fill a tile's ghost border from its neighbours. Rows are contiguous, the columns
+* are strided through the tile with an MPI_Type_vector, so nothing gets packed by hand.
+* A border more than one cell deep also needs its corners, from the diagonal neighbours. Those come for free
+* if the columns are exchanged first, and the rows after them carry the ghost columns along.
+*/
+class HaloMessages {
+public:
+	HaloMessages(const ProcessGrid& grid, int rows, int columns, int stride, int halo) : m_grid(grid), m_corners(halo > 1) {
+		MPI_Type_vector(halo, m_corners ? columns + 2 * halo : columns, stride, MPI_DOUBLE, &m_row_type);
+		MPI_Type_commit(&m_row_type);
+		MPI_Type_vector(rows, halo, stride, MPI_DOUBLE, &m_column_type);
+		MPI_Type_commit(&m_column_type);
+	}
+
+	HaloMessages(const HaloMessages&) = delete;
+	HaloMessages& operator=(const HaloMessages&) = delete;
+
+	~HaloMessages() {
+		MPI_Type_free(&m_row_type);
+		MPI_Type_free(&m_column_type);
+	}
+
+	/**
+	* Calls post(buffer, datatype, neighbour, tag, is_send) for every message of the tile, neighbours that are MPI_PROC_NULL included.
+	*/
+	template <typename F> void for_each(Tile& tile, F&& post) const {
+		for_each_column(tile, post);
+		for_each_row(tile, post);
+	}
+
+	template <typename F> void for_each_column(Tile& tile, F&& post) const {
+		int halo = tile.halo;
+		int last_column = tile.columns.count - halo;
+
+		post(tile.row(0), m_column_type, m_grid.left, TAG_LEFT, true);
+		post(tile.row(0) - halo, m_column_type, m_grid.left, TAG_RIGHT, false);
+		post(tile.row(0) + last_column, m_column_type, m_grid.right, TAG_RIGHT, true);
+		post(tile.row(0) + tile.columns.count, m_column_type, m_grid.right, TAG_LEFT, false);
+	}
+
+	template <typename F> void for_each_row(Tile& tile, F&& post) const {
+		int halo = tile.halo;
+		int last_row = tile.rows.count - halo;
+		// with corners, the rows start in the ghost columns
+		int first_column = m_corners ? -halo : 0;
+
+		post(tile.row(0) + first_column, m_row_type, m_grid.up, TAG_UP, true);
+		post(tile.row(-halo) + first_column, m_row_type, m_grid.up, TAG_DOWN, false);
+		post(tile.row(last_row) + first_column, m_row_type, m_grid.down, TAG_DOWN, true);
+		post(tile.row(tile.rows.count) + first_column, m_row_type, m_grid.down, TAG_UP, false);
+	}
+
+	/**
+	* Exchanges the ghost border and waits for it.
+	*/
+	void exchange(Tile& tile) const {
+		MPI_Request requests[8];
+		int count = 0;
+		auto post = [&](double* buffer, MPI_Datatype type, int neighbour, int tag, bool is_send) {
+			if (is_send) MPI_Isend(buffer, 1, type, neighbour, tag, m_grid.comm, &requests[count++]);
+			else MPI_Irecv(buffer, 1, type, neighbour, tag, m_grid.comm, &requests[count++]);
+		};
+
+		for_each_column(tile, post);
+		if (m_corners) {
+			// the rows send the ghost columns, so those have to be in first
+			MPI_Waitall(count, requests, MPI_STATUSES_IGNORE);
+			count = 0;
+		}
+		for_each_row(tile, post);
+		MPI_Waitall(count, requests, MPI_STATUSES_IGNORE);
+	}
+
+private:
+	const ProcessGrid& m_grid;
+	bool m_corners;
+	MPI_Datatype m_row_type;
+	MPI_Datatype m_column_type;
+};
+
+/**
+* Fills the ghost cells on the edges of the grid from the boundary condition.
+* They go reach cells into the ghost border along the edge, for the cells updated there with temporal blocking.
+*/
+void fill_boundary(Tile& tile, const ProcessGrid& grid, BoundaryCondition boundary, int reach);
+
+/**
+* Sets the sources anywhere in the tile, ghost border included, since with temporal blocking the border gets updated too.
+*/
+void set_sources(const HeatProblem& problem, Tile& tile);
+
+/**
+* Collects every rank's block into grid on rank 0. Both ends describe the block with a subarray type,
+* so it goes straight from the tile into its place in the grid.
+*/
+class FieldGather {
+public:
+	FieldGather(const ProcessGrid& grid, const Tile& tile, int rows, int columns) : m_grid(grid) {
+		int sizes[2] = { tile.rows.count + 2 * tile.halo, tile.stride };
+		int subsizes[2] = { tile.rows.count, tile.columns.count };
+		int starts[2] = { tile.halo, tile.halo };
+		MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &m_send_type);
+		MPI_Type_commit(&m_send_type);
+
+		if (grid.rank == 0) {
+			for (int r = 0; r < grid.size; r++) {
+				int coords[2];
+				MPI_Cart_coords(grid.comm, r, 2, coords);
+				BlockRange block_rows = block_range(rows, grid.dims[0], coords[0]);
+				BlockRange block_columns = block_range(columns, grid.dims[1], coords[1]);
+
+				int grid_sizes[2] = { rows, columns };
+				int block_sizes[2] = { block_rows.count, block_columns.count };
+				int block_starts[2] = { block_rows.start, block_columns.start };
+				m_receive_types.emplace_back();
+				MPI_Type_create_subarray(2, grid_sizes, block_sizes, block_starts, MPI_ORDER_C, MPI_DOUBLE, &m_receive_types.back());
+				MPI_Type_commit(&m_receive_types.back());
+			}
+		}
+	}
+
+	FieldGather(const FieldGather&) = delete;
+	FieldGather& operator=(const FieldGather&) = delete;
+
+	~FieldGather() {
+		MPI_Type_free(&m_send_type);
+		for (MPI_Datatype& type : m_receive_types) MPI_Type_free(&type);
+	}
+
+	void gather(const Tile& tile, std::vector<double>& field) {
+		std::vector<MPI_Request> requests;
+		if (m_grid.rank == 0) {
+			for (int r = 0; r < m_grid.size; r++) {
+				requests.emplace_back();
+				MPI_Irecv(field.data(), 1, m_receive_types[r], r, 0, m_grid.comm, &requests.back());
+			}
+		}
+		requests.emplace_back();
+		MPI_Isend(tile.cells.data(), 1, m_send_type, 0, 0, m_grid.comm, &requests.back());
+		MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+	}
+
+private:
+	const ProcessGrid& m_grid;
+	MPI_Datatype m_send_type;
+	std::vector<MPI_Datatype> m_receive_types; // one per rank, on rank 0
+};
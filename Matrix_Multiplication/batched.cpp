@@ -0,0 +1,193 @@
+#include "matrix.h"
+#include "small_gemm.h"
+
+#include <mpi.h>
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+using std::vector;
+
+constexpr double CHUNK_FLOPS = 1 << 24; // about this much work is handed out per request to the shared counter
+constexpr size_t CHUNK_BYTES = 1 << 20; // but no more small problems than fit in L2, so they are still there once generated
+
+// streams of RandomTools::uniform_at
+constexpr uint64_t STREAM_A = 0;
+constexpr uint64_t STREAM_B = 1;
+constexpr uint64_t STREAM_SIZES = 2;
+
+/**
+* Problems order[first] ... order[first + count - 1], all of the same size.
+*/
+struct BatchChunk {
+	int size;
+	int first;
+	int count;
+};
+
+struct BatchStats {
+	long long problems = 0;
+	long long chunks = 0;
+	double generation_time = 0;
+	double compute_time = 0;
+	double wait_time = 0; // asking for the next chunk
+	double checksum = 0;
+};
+
+/**
+* Generates and multiplies one chunk. The chunk is stored strided: the A, B and C of its problems are
+* each in one contiguous buffer, one size × size matrix after the other.
+*/
+template <typename T> void run_chunk(const Problem& problem, const BatchChunk& chunk, const vector<int>& order, vector<T>& a, vector<T>& b, vector<T>& c, BatchStats& stats) {
+	size_t elements = (size_t)chunk.size * chunk.size;
+	a.resize(elements * chunk.count);
+	b.resize(elements * chunk.count);
+	c.assign(elements * chunk.count, 0);
+
+	Timer generation_timer;
+	ThreadPool::instance().parallel_for(0, chunk.count, [&](long long first, long long last) {
+		for (long long i = first; i < last; i++) {
+			uint64_t index = (uint64_t)order[chunk.first + i] << 32;
+			for (size_t e = 0; e < elements; e++) {
+				a[elements * i + e] = RandomTools::uniform_at<T>(problem.seed, STREAM_A, index | e);
+				b[elements * i + e] = RandomTools::uniform_at<T>(problem.seed, STREAM_B, index | e);
+			}
+		}
+	});
+	stats.generation_time += generation_timer.stop().count();
+
+	Timer compute_timer;
+	Gemm::SmallKernel<T> small_kernel = Gemm::small_kernel<T>(chunk.size);
+
+	// a chunk of one big problem is parallel inside the kernel, a chunk of many small ones over the problems
+	ThreadPool::instance().parallel_for(0, chunk.count, [&](long long first, long long last) {
+		for (long long i = first; i < last; i++) {
+			size_t offset = elements * i;
+			if (small_kernel) {
+				small_kernel(a.data() + offset, b.data() + offset, c.data() + offset);
+			}
+			else {
+				Gemm::gemm(problem.kernel, chunk.size, chunk.size, chunk.size, a.data() + offset, chunk.size, b.data() + offset, chunk.size, c.data() + offset, chunk.size);
+			}
+		}
+	});
+	stats.compute_time += compute_timer.stop().count();
+
+	for (T value : c) stats.checksum += value;
+	stats.problems += chunk.count;
+	stats.chunks++;
+}
+
+template <typename T> int run_batched_typed(const Problem& problem, const RunOptions& options) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	int world_size;
+	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+	const vector<int>& sizes = options.batch_sizes;
+	int count = options.batch_count;
+
+	// every rank works out the same sizes and chunks on its own
+	vector<int> problem_sizes(count);
+	double flops = 0;
+	for (int i = 0; i < count; i++) {
+		int pick = (int)(RandomTools::uniform_at(problem.seed, STREAM_SIZES, i) * sizes.size());
+		problem_sizes[i] = sizes[pick];
+		flops += 2.0 * problem_sizes[i] * problem_sizes[i] * problem_sizes[i];
+	}
+
+	// the biggest problems go out first, so the small chunks at the end even out the finishing times
+	vector<int> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return problem_sizes[x] > problem_sizes[y]; });
+
+	vector<BatchChunk> chunks;
+	for (int first = 0; first < count;) {
+		int size = problem_sizes[order[first]];
+		int per_chunk = std::max(1, (int)std::min(CHUNK_FLOPS / (2.0 * size * size * size), (double)CHUNK_BYTES / (3.0 * sizeof(T) * size * size)));
+		int last = first;
+		while (last < count && last - first < per_chunk && problem_sizes[order[last]] == size) last++;
+		chunks.push_back({ size, first, last - first });
+		first = last;
+	}
+
+	if (rank == 0) {
+		std::cout << "Batch of " << count << " square products (" << ((sizeof(T) == sizeof(float)) ? "float" : "double") << "), sizes";
+		for (int size : sizes) std::cout << " " << size << (Gemm::small_kernel<T>(size) ? "*" : "");
+		std::cout << ", seed " << problem.seed << std::endl;
+		std::cout << "* specialized kernel, the rest use the " << Gemm::kernel_name(problem.kernel) << " kernel (" << Gemm::SIMD_NAME << ")" << std::endl;
+		std::cout << chunks.size() << " chunks handed out through a shared counter." << std::endl;
+		std::cout << std::endl;
+	}
+
+	// the next chunk to hand out, on rank 0, bumped by whoever is free with MPI_Fetch_and_op
+	long long* next_chunk;
+	MPI_Win window;
+	MPI_Win_allocate((rank == 0) ? sizeof(long long) : 0, sizeof(long long), MPI_INFO_NULL, MPI_COMM_WORLD, &next_chunk, &window);
+	MPI_Win_lock_all(0, window);
+	if (rank == 0) {
+		*next_chunk = 0;
+		MPI_Win_sync(window);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	BatchStats stats;
+	vector<T> a;
+	vector<T> b;
+	vector<T> c;
+
+	Timer timer;
+	while (true) {
+		Timer wait_timer;
+		long long one = 1;
+		long long index;
+		MPI_Fetch_and_op(&one, &index, MPI_LONG_LONG, 0, 0, MPI_SUM, window);
+		MPI_Win_flush(0, window);
+		stats.wait_time += wait_timer.stop().count();
+
+		if (index >= (long long)chunks.size()) break;
+
+		run_chunk(problem, chunks[index], order, a, b, c, stats);
+	}
+	double time = timer.stop().count();
+
+	MPI_Win_unlock_all(window);
+	MPI_Win_free(&window);
+
+	// the inputs of a real batch would already be there, so their generation isn't counted
+	double busy_time = time - stats.generation_time;
+	double max_time;
+	double max_busy_time;
+	double checksum;
+	MPI_Reduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&busy_time, &max_busy_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&stats.checksum, &checksum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+	// how the dynamic balancing shared the work out
+	constexpr int STATS = 5;
+	double per_rank[STATS] = { (double)stats.chunks, (double)stats.problems, stats.compute_time, stats.generation_time, stats.wait_time };
+	vector<double> all_ranks((rank == 0) ? STATS * world_size : 0);
+	MPI_Gather(per_rank, STATS, MPI_DOUBLE, all_ranks.data(), STATS, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+	if (rank == 0) {
+		for (int i = 0; i < world_size; i++) {
+			const double* stat = all_ranks.data() + STATS * i;
+			std::cout << "Rank " << i << " ran " << stat[0] << " chunks, " << stat[1] << " products. Computing took "
+				<< stat[2] << " seconds, generating " << stat[3] << " and waiting for work " << stat[4] << "." << std::endl;
+		}
+
+		std::cout << "Output checksum: " << std::setprecision(12) << checksum << std::setprecision(6) << std::endl;
+		std::cout << "Slowest rank took " << max_time << " seconds, " << max_busy_time << " without generating the inputs." << std::endl;
+		std::cout << "Achieved " << count / max_busy_time << " matrices/s, " << flops / max_busy_time / 1e9 << " GFLOP/s." << std::endl;
+	}
+
+	return 0;
+}
+
+int run_batched(const Problem& problem, const RunOptions& options, int element_size) {
+	if (element_size == sizeof(float)) {
+		return run_batched_typed<float>(problem, options);
+	}
+	return run_batched_typed<double>(problem, options);
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../thread_pool.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+* Local (single rank) matrix multiplication kernels.
+* All matrices are row-major, and every kernel computes C += A * B,
+* where A is m×k, B is k×n and C is m×n.
+*/
+namespace Gemm {
+	enum class Kernel {
+		Naive,	// the original i-j-k loop, kept around for comparison
+		Tiled,	// packed, cache-blocked and register-tiled
+	};
+
+	/**
+	* @return false if there is no kernel called name.
+	*/
+	inline bool kernel_from_name(const std::string& name, Kernel& kernel) {
+		if (name == "naive") kernel = Kernel::Naive;
+		else if (name == "tiled") kernel = Kernel::Tiled;
+		else return false;
+		return true;
+	}
+
+	inline const char* kernel_name(Kernel kernel) {
+		return (kernel == Kernel::Naive) ? "naive" : "tiled";
+	}
+
+	// A thin wrapper over whatever vector registers the compiler was told it could use.
+	// MR × (NV * WIDTH) is the size of the register tile computed by the micro-kernel.
+	template <typename T> struct Vec;
+
+#if defined(__AVX512F__)
+	constexpr const char* SIMD_NAME = "AVX-512";
+	template <> struct Vec<double> {
+		static constexpr int WIDTH = 8;
+		static constexpr int MR = 8;
+		static constexpr int NV = 2;
+		__m512d v;
+
+		static Vec zero() { return { _mm512_setzero_pd() }; }
+		static Vec load(const double* p) { return { _mm512_loadu_pd(p) }; }
+		static Vec broadcast(double x) { return { _mm512_set1_pd(x) }; }
+		static Vec fmadd(Vec a, Vec b, Vec c) { return { _mm512_fmadd_pd(a.v, b.v, c.v) }; }
+		static Vec add(Vec a, Vec b) { return { _mm512_add_pd(a.v, b.v) }; }
+		void store(double* p) const { _mm512_storeu_pd(p, v); }
+	};
+	template <> struct Vec<float> {
+		static constexpr int WIDTH = 16;
+		static constexpr int MR = 8;
+		static constexpr int NV = 2;
+		__m512 v;
+
+		static Vec zero() { return { _mm512_setzero_ps() }; }
+		static Vec load(const float* p) { return { _mm512_loadu_ps(p) }; }
+		static Vec broadcast(float x) { return { _mm512_set1_ps(x) }; }
+		static Vec fmadd(Vec a, Vec b, Vec c) { return { _mm512_fmadd_ps(a.v, b.v, c.v) }; }
+		static Vec add(Vec a, Vec b) { return { _mm512_add_ps(a.v, b.v) }; }
+		void store(float* p) const { _mm512_storeu_ps(p, v); }
+	};
+#elif defined(__AVX2__)
+	constexpr const char* SIMD_NAME = "AVX2";
+	template <> struct Vec<double> {
+		static constexpr int WIDTH = 4;
+		static constexpr int MR = 6;
+		static constexpr int NV = 2;
+		__m256d v;
+
+		static Vec zero() { return { _mm256_setzero_pd() }; }
+		static Vec load(const double* p) { return { _mm256_loadu_pd(p) }; }
+		static Vec broadcast(double x) { return { _mm256_set1_pd(x) }; }
+#if defined(__FMA__) || defined(_MSC_VER)
+		static Vec fmadd(Vec a, Vec b, Vec c) { return { _mm256_fmadd_pd(a.v, b.v, c.v) }; }
+#else
+		static Vec fmadd(Vec a, Vec b, Vec c) { return { _mm256_add_pd(_mm256_mul_pd(a.v, b.v), c.v) }; }
+#endif
+		static Vec add(Vec a, Vec b) { return { _mm256_add_pd(a.v, b.v) }; }
+		void store(double* p) const { _mm256_storeu_pd(p, v); }
+	};
+	template <> struct Vec<float> {
+		static constexpr int WIDTH = 8;
+		static constexpr int MR = 6;
+		static constexpr int NV = 2;
+		__m256 v;
+
+		static Vec zero() { return { _mm256_setzero_ps() }; }
+		static Vec load(const float* p) { return { _mm256_loadu_ps(p) }; }
+		static Vec broadcast(float x) { return { _mm256_set1_ps(x) }; }
+#if defined(__FMA__) || defined(_MSC_VER)
+		static Vec fmadd(Vec a, Vec b, Vec c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+#else
+		static Vec fmadd(Vec a, Vec b, Vec c) { return { _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v) }; }
+#endif
+		static Vec add(Vec a, Vec b) { return { _mm256_add_ps(a.v, b.v) }; }
+		void store(float* p) const { _mm256_storeu_ps(p, v); }
+	};
+#else
+	constexpr const char* SIMD_NAME = "scalar";
+	template <typename T> struct Vec {
+		static constexpr int WIDTH = 1;
+		static constexpr int MR = 4;
+		static constexpr int NV = 4;
+		T v;
+
+		static Vec zero() { return { 0 }; }
+		static Vec load(const T* p) { return { *p }; }
+		static Vec broadcast(T x) { return { x }; }
+		static Vec fmadd(Vec a, Vec b, Vec c) { return { a.v * b.v + c.v }; }
+		static Vec add(Vec a, Vec b) { return { a.v + b.v }; }
+		void store(T* p) const { *p = v; }
+	};
+#endif
+	// Cache blocking. A KC × NR sliver of B stays in L1 across a row of micro-tiles,
+	// an MC × KC block of A stays in L2, and a KC × NC panel of B is meant for L3.
+	constexpr int KC = 256;
+
+	template <typename T> struct Tile {
+		static constexpr int MR = Vec<T>::MR;
+		static constexpr int NR = Vec<T>::NV * Vec<T>::WIDTH;
+		static constexpr int MC = MR * 16;
+		static constexpr int NC = NR * 256;
+	};
+
+	/**
+	* The original triple loop. Strides down B for every element of C.
+	*/
+	template <typename T> void gemm_naive(int m, int n, int k, const T* a, int lda, const T* b, int ldb, T* c, int ldc) {
+		for (int i = 0; i < m; i++) {
+			for (int j = 0; j < n; j++) {
+				for (int p = 0; p < k; p++) {
+					c[(size_t)i * ldc + j] += a[(size_t)i * lda + p] * b[(size_t)p * ldb + j];
+				}
+			}
+		}
+	}
+
+	/**
+	* Copies an mc × kc block of A into MR-row panels, so the micro-kernel reads it sequentially.
+	* Rows past mc are zero padded.
+	*/
+	template <typename T> void pack_a(int mc, int kc, const T* a, int lda, T* packed) {
+		constexpr int MR = Tile<T>::MR;
+
+		for (int ir = 0; ir < mc; ir += MR) {
+			int mr = std::min(MR, mc - ir);
+			for (int p = 0; p < kc; p++) {
+				for (int i = 0; i < mr; i++) {
+					packed[i] = a[(size_t)(ir + i) * lda + p];
+				}
+				for (int i = mr; i < MR; i++) {
+					packed[i] = 0;
+				}
+				packed += MR;
+			}
+		}
+	}
+
+	/**
+	* Copies a kc × nc panel of B into NR-column slivers. Columns past nc are zero padded.
+	*/
+	template <typename T> void pack_b(int kc, int nc, const T* b, int ldb, T* packed) {
+		constexpr int NR = Tile<T>::NR;
+
+		for (int jr = 0; jr < nc; jr += NR) {
+			int nr = std::min(NR, nc - jr);
+			for (int p = 0; p < kc; p++) {
+				const T* row = b + (size_t)p * ldb + jr;
+				for (int j = 0; j < nr; j++) {
+					packed[j] = row[j];
+				}
+				for (int j = nr; j < NR; j++) {
+					packed[j] = 0;
+				}
+				packed += NR;
+			}
+		}
+	}
+
+	/**
+	* C[MR × NR] += (packed A sliver) * (packed B sliver), with the whole tile of C held in registers.
+	*/
+	template <typename T> void micro_kernel(int kc, const T* a, const T* b, T* c, int ldc) {
+		using V = Vec<T>;
+		constexpr int MR = Tile<T>::MR;
+		constexpr int NR = Tile<T>::NR;
+		constexpr int NV = V::NV;
+
+		V acc[MR][NV];
+		for (int i = 0; i < MR; i++) {
+			for (int v = 0; v < NV; v++) {
+				acc[i][v] = V::zero();
+			}
+		}
+
+		for (int p = 0; p < kc; p++) {
+			V b_row[NV];
+			for (int v = 0; v < NV; v++) {
+				b_row[v] = V::load(b + v * V::WIDTH);
+			}
+			for (int i = 0; i < MR; i++) {
+				V a_value = V::broadcast(a[i]);
+				for (int v = 0; v < NV; v++) {
+					acc[i][v] = V::fmadd(a_value, b_row[v], acc[i][v]);
+				}
+			}
+			a += MR;
+			b += NR;
+		}
+
+		for (int i = 0; i < MR; i++) {
+			for (int v = 0; v < NV; v++) {
+				T* target = c + (size_t)i * ldc + v * V::WIDTH;
+				V::add(V::load(target), acc[i][v]).store(target);
+			}
+		}
+	}
+
+	/**
+	* Runs the micro-kernel on a tile that may be cut off by the edge of C.
+	*/
+	template <typename T> void edge_kernel(int mr, int nr, int kc, const T* a, const T* b, T* c, int ldc) {
+		constexpr int MR = Tile<T>::MR;
+		constexpr int NR = Tile<T>::NR;
+
+		if (mr == MR && nr == NR) {
+			micro_kernel(kc, a, b, c, ldc);
+			return;
+		}
+
+		T tile[MR * NR] = {};
+		micro_kernel(kc, a, b, tile, NR);
+		for (int i = 0; i < mr; i++) {
+			for (int j = 0; j < nr; j++) {
+				c[(size_t)i * ldc + j] += tile[i * NR + j];
+			}
+		}
+	}
+
+	/**
+	* Cache-blocked GEMM built on packed panels and the register-tiled micro-kernel.
+	* Blocks of rows of C are shared out over the thread pool, each thread packing its own block of A.
+	*/
+	template <typename T> void gemm_tiled(int m, int n, int k, const T* a, int lda, const T* b, int ldb, T* c, int ldc) {
+		constexpr int MR = Tile<T>::MR;
+		constexpr int NR = Tile<T>::NR;
+		constexpr int MC = Tile<T>::MC;
+		constexpr int NC = Tile<T>::NC;
+
+		// small products only get buffers as big as they need
+		size_t kc_max = std::min(KC, k);
+		size_t mc_max = std::min(MC, (m + MR - 1) / MR * MR);
+		size_t nc_max = std::min(NC, (n + NR - 1) / NR * NR);
+
+		ThreadPool& pool = ThreadPool::instance();
+		std::vector<std::vector<T>> packed_a(pool.size(), std::vector<T>(mc_max * kc_max));
+		std::vector<T> packed_b(kc_max * nc_max);
+
+		for (int jc = 0; jc < n; jc += NC) {
+			int nc = std::min(NC, n - jc);
+
+			for (int pc = 0; pc < k; pc += KC) {
+				int kc = std::min(KC, k - pc);
+
+				int slivers = (nc + NR - 1) / NR;
+				pool.parallel_for(0, slivers, [&](long long first, long long last) {
+					int jr = (int)first * NR;
+					int width = std::min(nc, (int)last * NR) - jr;
+					pack_b(kc, width, b + (size_t)pc * ldb + jc + jr, ldb, packed_b.data() + (size_t)jr * kc);
+				});
+
+				pool.run((m + MC - 1) / MC, [&](int block) {
+					int ic = block * MC;
+					int mc = std::min(MC, m - ic);
+					T* packed = packed_a[ThreadPool::thread_index()].data();
+					pack_a(mc, kc, a + (size_t)ic * lda + pc, lda, packed);
+
+					for (int jr = 0; jr < nc; jr += NR) {
+						int nr = std::min(NR, nc - jr);
+						for (int ir = 0; ir < mc; ir += MR) {
+							int mr = std::min(MR, mc - ir);
+							edge_kernel(mr, nr, kc,
+								packed + (size_t)ir * kc,
+								packed_b.data() + (size_t)jr * kc,
+								c + (size_t)(ic + ir) * ldc + jc + jr, ldc);
+						}
+					}
+				});
+			}
+		}
+	}
+
+	template <typename T> void gemm(Kernel kernel, int m, int n, int k, const T* a, int lda, const T* b, int ldb, T* c, int ldc) {
+		switch (kernel) {
+		case Kernel::Naive:
+			gemm_naive(m, n, k, a, lda, b, ldb, c, ldc);
+			break;
+		case Kernel::Tiled:
+		default:
+			gemm_tiled(m, n, k, a, lda, b, ldb, c, ldc);
+			break;
+		}
+	}
+}
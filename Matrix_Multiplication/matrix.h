@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../helpers.h"
+#include "gemm.h"
+
+#include <mpi.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Types shared by the parts of the matrix multiplication program.
+
+enum class Distribution {
+	Rows,	// row slabs of A, all of B on everyone
+	Summa,	// 2D blocks of A, B and C on a process grid
+	Strassen,	// all of A and B on everyone, the top Strassen-Winograd products shared out, row slabs of C
+	Batched,	// many independent small products, handed out to whoever is free
+};
+
+/**
+* @return false if there is no distribution called name.
+*/
+inline bool distribution_from_name(const std::string& name, Distribution& distribution) {
+	if (name == "rows") distribution = Distribution::Rows;
+	else if (name == "summa") distribution = Distribution::Summa;
+	else if (name == "strassen") distribution = Distribution::Strassen;
+	else if (name == "batched") distribution = Distribution::Batched;
+	else return false;
+	return true;
+}
+
+/**
+* C (m×n) = A (m×k) * B (k×n)
+*/
+struct Problem {
+	int m;
+	int k;
+	int n;
+	Gemm::Kernel kernel;
+	uint64_t seed;
+};
+
+/**
+* Everything about a run that isn't the problem itself.
+*/
+struct RunOptions {
+	Distribution distribution = Distribution::Rows;
+	bool gather = false;	// collect the whole output on rank 0
+	bool map = false;		// memory-map input files instead of reading them, single rank only
+	int strassen_cutoff = 256;	// Strassen-Winograd stops recursing once a dimension would drop below this
+	int verify_vectors = 0;		// random vectors for the Freivalds check of the result, none to skip it
+	bool pipeline = false;		// overlap communication with computation using nonblocking collectives
+	int chunk = 0;				// SUMMA panel width, or rows per chunk when pipelining the row distribution, 0 for the defaults
+
+	// batched mode: how many square products, and the sizes they are picked from
+	int batch_count = 4096;
+	std::vector<int> batch_sizes = { 8, 16, 32, 64, 128, 256 };
+
+	// matrix files to read the inputs from and write the inputs and output to, unused if empty
+	std::string load_a;
+	std::string load_b;
+	std::string store_a;
+	std::string store_b;
+	std::string store_c;
+};
+
+/**
+* The part of a matrix held by one rank, stored row-major.
+*/
+struct Block {
+	BlockRange rows;
+	BlockRange columns;
+
+	size_t size() const { return (size_t)rows.count * columns.count; }
+};
+
+struct Layout {
+	Block a;
+	Block b;
+	Block c;
+};
+
+/**
+* The ranks arranged as a dims[0] × dims[1] grid. The row distribution is a P × 1 grid.
+*/
+struct ProcessGrid {
+	MPI_Comm grid;
+	MPI_Comm row_comm;		// the ranks in my grid row, rank in it is coords[1]
+	MPI_Comm column_comm;	// the ranks in my grid column, rank in it is coords[0]
+	int dims[2];
+	int coords[2];
+	int rank;
+	int size;
+};
+
+struct MultiplyStats {
+	double compute_time = 0;
+	double communication_time = 0;
+	bool gathered = false;	// the output already streamed to rank 0 during the multiply
+
+	// set by modes that also run the classical path to compare against
+	double reference_time = 0;
+	double reference_error = 0;	// largest difference from the classical result, relative to its largest element
+};
+
+template <typename T> MPI_Datatype mpi_datatype();
+template <> inline MPI_Datatype mpi_datatype<double>() { return MPI_DOUBLE; }
+template <> inline MPI_Datatype mpi_datatype<float>() { return MPI_FLOAT; }
+
+/**
+* Runs the batched mode, which has its own driver in batched.cpp.
+*/
+int run_batched(const Problem& problem, const RunOptions& options, int element_size);
@@ -0,0 +1,93 @@
+#include "matrix_io.h"
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool read_matrix_header(const std::string& path, MatrixHeader& header) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		std::cerr << "Error opening " << path << " for reading.\n";
+		return false;
+	}
+
+	std::streamoff file_size = file.tellg();
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "PCMX", 4) != 0) {
+		std::cerr << "Error: " << path << " is not a matrix file.\n";
+		return false;
+	}
+
+	if (header.version != MATRIX_FILE_VERSION || (header.element_size != sizeof(float) && header.element_size != sizeof(double))) {
+		std::cerr << "Error: " << path << " has an unsupported version or element type.\n";
+		return false;
+	}
+
+	// dimensions are ints everywhere else, and a larger one would wrap around
+	if (header.rows > INT_MAX || header.columns > INT_MAX) {
+		std::cerr << "Error: " << path << " is " << header.rows << " x " << header.columns << ", dimensions can be at most " << INT_MAX << ".\n";
+		return false;
+	}
+
+	if ((uint64_t)file_size < sizeof(header) + header.rows * header.columns * header.element_size) {
+		std::cerr << "Error: " << path << " is shorter than its header says.\n";
+		return false;
+	}
+
+	return true;
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		m_file = nullptr;
+		return;
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(m_file, &size);
+	m_size = (size_t)size.QuadPart;
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping) {
+		m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file) CloseHandle(m_file);
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+	m_fd = open(path.c_str(), O_RDONLY);
+	if (m_fd < 0) return;
+
+	struct stat info;
+	if (fstat(m_fd, &info) != 0 || info.st_size == 0) return;
+	m_size = (size_t)info.st_size;
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (data != MAP_FAILED) {
+		m_data = static_cast<const char*>(data);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (m_data) munmap(const_cast<char*>(m_data), m_size);
+	if (m_fd >= 0) close(m_fd);
+}
+#endif
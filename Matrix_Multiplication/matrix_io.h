@@ -0,0 +1,144 @@
+#pragma once
+
+#include "matrix.h"
+
+#include <mpi.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+* On-disk matrix format: a 32 byte header followed by rows × columns elements, row-major,
+* in the byte order of the machine that wrote it.
+*/
+struct MatrixHeader {
+	char magic[4];			// "PCMX"
+	uint32_t version;
+	uint32_t element_size;	// 4 for float, 8 for double
+	uint32_t reserved;
+	uint64_t rows;
+	uint64_t columns;
+};
+static_assert(sizeof(MatrixHeader) == 32, "MatrixHeader must match the on-disk layout");
+
+constexpr uint32_t MATRIX_FILE_VERSION = 1;
+
+/**
+* Reads and checks the header of a matrix file. Only needs to be called on one rank.
+* @return Whether the file exists and has a valid header, with dimensions that fit in an int.
+*/
+bool read_matrix_header(const std::string& path, MatrixHeader& header);
+
+/**
+* A read-only memory mapping of a whole file.
+*/
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool is_open() const { return m_data != nullptr; }
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
+
+/**
+* A file view that selects one rank's block of a rows × columns matrix, so a single collective call moves it.
+* Ranks with an empty block get a view with nothing in it.
+*/
+template <typename T> MPI_Datatype block_filetype(const Block& block, int rows, int columns) {
+	MPI_Datatype filetype;
+	if (block.size() == 0) {
+		MPI_Type_contiguous(0, mpi_datatype<T>(), &filetype);
+	}
+	else {
+		int sizes[2] = { rows, columns };
+		int subsizes[2] = { block.rows.count, block.columns.count };
+		int starts[2] = { block.rows.start, block.columns.start };
+		MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, mpi_datatype<T>(), &filetype);
+	}
+	MPI_Type_commit(&filetype);
+	return filetype;
+}
+
+/**
+* One row of a block, the unit blocks are read and written in, so large blocks don't overflow MPI's int counts.
+*/
+template <typename T> MPI_Datatype block_row_type(const Block& block) {
+	MPI_Datatype row;
+	MPI_Type_contiguous(block.columns.count, mpi_datatype<T>(), &row);
+	MPI_Type_commit(&row);
+	return row;
+}
+
+/**
+* Collectively reads every rank's block of a matrix file straight into its local buffer with MPI-IO.
+* @return Whether the read succeeded, the same on every rank.
+*/
+template <typename T> bool read_matrix_block(const std::string& path, const Block& block, int rows, int columns, std::vector<T>& local, MPI_Comm comm) {
+	MPI_File file;
+	if (MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+		return false;
+	}
+
+	local.resize(block.size());
+	MPI_Datatype filetype = block_filetype<T>(block, rows, columns);
+	MPI_File_set_view(file, sizeof(MatrixHeader), mpi_datatype<T>(), filetype, "native", MPI_INFO_NULL);
+	MPI_Datatype row = block_row_type<T>(block);
+	int rc = MPI_File_read_at_all(file, 0, local.data(), (block.size() > 0) ? block.rows.count : 0, row, MPI_STATUS_IGNORE);
+
+	MPI_Type_free(&row);
+	MPI_Type_free(&filetype);
+	MPI_File_close(&file);
+
+	int ok = rc == MPI_SUCCESS;
+	MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+	return ok;
+}
+
+/**
+* Collectively writes every rank's block of a rows × columns matrix into one file with MPI-IO.
+* Nothing is funnelled through a single rank. Ranks holding a copy of a block someone else writes should pass an empty block.
+* @return Whether the write succeeded, the same on every rank.
+*/
+template <typename T> bool write_matrix_block(const std::string& path, const Block& block, int rows, int columns, const T* local, MPI_Comm comm) {
+	int rank;
+	MPI_Comm_rank(comm, &rank);
+
+	MPI_File file;
+	if (MPI_File_open(comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+		return false;
+	}
+	MPI_File_set_size(file, sizeof(MatrixHeader) + (MPI_Offset)rows * columns * sizeof(T));
+
+	MatrixHeader header = { { 'P', 'C', 'M', 'X' }, MATRIX_FILE_VERSION, (uint32_t)sizeof(T), 0, (uint64_t)rows, (uint64_t)columns };
+	int rc = MPI_File_write_at_all(file, 0, &header, (rank == 0) ? sizeof(header) : 0, MPI_BYTE, MPI_STATUS_IGNORE);
+
+	MPI_Datatype filetype = block_filetype<T>(block, rows, columns);
+	MPI_File_set_view(file, sizeof(MatrixHeader), mpi_datatype<T>(), filetype, "native", MPI_INFO_NULL);
+	MPI_Datatype row = block_row_type<T>(block);
+	if (rc == MPI_SUCCESS) {
+		rc = MPI_File_write_at_all(file, 0, local, (block.size() > 0) ? block.rows.count : 0, row, MPI_STATUS_IGNORE);
+	}
+
+	MPI_Type_free(&row);
+	MPI_Type_free(&filetype);
+	MPI_File_close(&file);
+
+	int ok = rc == MPI_SUCCESS;
+	MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+	return ok;
+}
@@ -1,98 +1,851 @@
 #include "../programs.h"
+#include "matrix.h"
+#include "matrix_io.h"
+#include "strassen.h"
+#include "verify.h"
 
 #include <mpi.h>
 #include <string>
 #include <random>
 #include <cmath>
 #include <numbers>
+#include <memory>
+#include <span>
+#include <sstream>
 #include <vector>
 
+using std::vector;
+
+// These are defaults, overridden if arguments are provided.
 constexpr int MATRIX_ROWS = 1000;
 constexpr int MATRIX_COLUMNS = 1000;
 
-int matrix_multiplication(Arguments args) {
-	using std::vector;
+constexpr int PEEK_SIZE = 5;
+constexpr int SUMMA_PANEL_WIDTH = 128; // columns of A (rows of B) broadcast per SUMMA step
+constexpr int PIPELINE_ROWS = 64; // rows of the output computed and sent back per step of the pipelined row distribution
+constexpr int PIPELINE_POLLS = 4; // pieces a pipelined SUMMA step is computed in, poking MPI in between so transfers keep moving
+constexpr int VERIFY_VECTORS = 3; // random vectors per check, an error has to slip past every one of them to go unnoticed
+
+// streams of RandomTools::uniform_at, one per generated matrix
+constexpr uint64_t STREAM_A = 0;
+constexpr uint64_t STREAM_B = 1;
+
+ProcessGrid make_grid(Distribution distribution);
+void free_grid(ProcessGrid& grid);
+Layout layout_of(const Problem& problem, Distribution distribution, const int dims[2], const int coords[2]);
+
+bool read_input_shapes(Problem& problem, const RunOptions& options, int& element_size);
+
+template <typename T> int run_multiplication(const Problem& problem, const RunOptions& options);
+template <typename T> void gather_blocks(const vector<T>& local, const Block& block, vector<T>& matrix, int columns, const ProcessGrid& grid);
+template <typename T> MultiplyStats multiply_local(const Problem& problem, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c);
+template <typename T> MultiplyStats multiply_rows_pipelined(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c, vector<T>& output);
+template <typename T> MultiplyStats multiply_summa(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c);
+template <typename T> MultiplyStats multiply_summa_pipelined(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c);
+template <typename T> MultiplyStats multiply_strassen(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> a, std::span<const T> b, vector<T>& local_c);
 
+int matrix_multiplication(Arguments args) {
 	int rank;
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-	int world_size;
-	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
 
+	Problem problem = { MATRIX_ROWS, MATRIX_COLUMNS, MATRIX_COLUMNS, Gemm::Kernel::Tiled, 0 };
+
+	if (args.len() >= 3) {
+		problem.m = std::stoi(args.get(0));
+		problem.k = std::stoi(args.get(1));
+		problem.n = std::stoi(args.get(2));
+	}
+	else if (args.len() >= 1) {
+		problem.m = problem.k = problem.n = std::stoi(args.get(0));
+	}
+
+	std::string kernel_name = args.option("kernel", "tiled");
+	if (!Gemm::kernel_from_name(kernel_name, problem.kernel)) {
+		if (rank == 0) std::cerr << "Error: unknown kernel " << kernel_name << ", it has to be naive or tiled.\n";
+		return 1;
+	}
+
+	RunOptions options;
+	std::string mode = args.option("mode", "rows");
+	if (!distribution_from_name(mode, options.distribution)) {
+		if (rank == 0) std::cerr << "Error: unknown mode " << mode << ", it has to be rows, summa, strassen or batched.\n";
+		return 1;
+	}
+	options.strassen_cutoff = args.option_int("cutoff", options.strassen_cutoff);
+	options.verify_vectors = args.has_option("verify") ? args.option_int("verify", VERIFY_VECTORS) : 0;
+	options.pipeline = args.has_option("pipeline");
+	options.chunk = args.option_int("chunk", 0);
+	options.gather = args.has_option("gather");
+	options.map = args.has_option("mmap");
+	options.load_a = args.option("load-a");
+	options.load_b = args.option("load-b");
+	options.store_a = args.option("store-a");
+	options.store_b = args.option("store-b");
+	options.store_c = args.option("store-c");
+	options.batch_count = args.option_int("batch", options.batch_count);
+	if (args.has_option("sizes")) {
+		options.batch_sizes.clear();
+		std::stringstream sizes(args.option("sizes"));
+		for (std::string size; std::getline(sizes, size, ',');) {
+			options.batch_sizes.push_back(std::stoi(size));
+		}
+	}
+
+	// every rank has to agree on the seed, since they all generate their own part of the same matrices
 	std::random_device rd;
-	std::mt19937 rng(rd() ^ rank * RANDOM_SEED_MULTIPLIER);
-	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	unsigned long long seed = args.has_option("seed") ? std::stoull(args.option("seed")) : rd();
+	MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+	problem.seed = seed;
 
-	vector<double> matrix_a;
-	vector<double> matrix_b;
+	// loaded matrices bring their own shape and element type
+	int element_size = (args.option("type", "double") == "float") ? sizeof(float) : sizeof(double);
+	if (!read_input_shapes(problem, options, element_size)) {
+		return 1;
+	}
 
-	matrix_a.resize(MATRIX_ROWS * MATRIX_COLUMNS);
-	matrix_b.resize(MATRIX_ROWS * MATRIX_COLUMNS);
+	if (options.distribution == Distribution::Batched) {
+		return run_batched(problem, options, element_size);
+	}
+
+	if (element_size == sizeof(float)) {
+		return run_multiplication<float>(problem, options);
+	}
+	return run_multiplication<double>(problem, options);
+}
+
+/**
+* Takes the dimensions and element type of the problem from the input files, if there are any, and checks they fit together.
+* @return Whether the inputs are usable, the same on every rank.
+*/
+bool read_input_shapes(Problem& problem, const RunOptions& options, int& element_size) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	if (options.load_a.empty() && options.load_b.empty()) return true;
+
+	int shape[5] = { 1, problem.m, problem.k, problem.n, element_size };
 
 	if (rank == 0) {
-		for (int i = 0; i < MATRIX_ROWS; i++) {
-			for (int j = 0; j < MATRIX_COLUMNS; j++) {
-				matrix_a[i * MATRIX_COLUMNS + j] = dist(rng);
-				matrix_b[i * MATRIX_COLUMNS + j] = dist(rng);
+		MatrixHeader a_header;
+		MatrixHeader b_header;
+		bool ok = true;
+
+		if (!options.load_a.empty()) {
+			ok = ok && read_matrix_header(options.load_a, a_header);
+			if (ok) {
+				shape[1] = (int)a_header.rows;
+				shape[2] = (int)a_header.columns;
+				shape[4] = (int)a_header.element_size;
 			}
 		}
+
+		if (!options.load_b.empty()) {
+			ok = ok && read_matrix_header(options.load_b, b_header);
+			if (ok && !options.load_a.empty() && (b_header.rows != a_header.columns || b_header.element_size != a_header.element_size)) {
+				std::cerr << "Error: the columns and element type of A have to match the rows and element type of B.\n";
+				ok = false;
+			}
+			if (ok) {
+				shape[2] = (int)b_header.rows;
+				shape[3] = (int)b_header.columns;
+				shape[4] = (int)b_header.element_size;
+			}
+		}
+
+		shape[0] = ok;
 	}
 
-	if (rank == 0) {
+	MPI_Bcast(shape, 5, MPI_INT, 0, MPI_COMM_WORLD);
+	problem.m = shape[1];
+	problem.k = shape[2];
+	problem.n = shape[3];
+	element_size = shape[4];
+
+	return shape[0];
+}
+
+/**
+* Fills a rank's block of a matrix straight from the seeded generator, so nothing is generated on one rank and shipped.
+*/
+template <typename T> void generate_block(vector<T>& local, const Block& block, int columns, uint64_t seed, uint64_t stream) {
+	local.resize(block.size());
+
+	ThreadPool::instance().parallel_for(0, block.rows.count, [&](long long first, long long last) {
+		for (long long i = first; i < last; i++) {
+			size_t row = (size_t)(block.rows.start + i);
+			for (int j = 0; j < block.columns.count; j++) {
+				local[i * block.columns.count + j] = RandomTools::uniform_at<T>(seed, stream, row * columns + block.columns.start + j);
+			}
+		}
+	});
+}
+
+/**
+* A rank's block of an input matrix, either in memory or mapped straight from its file.
+*/
+template <typename T> struct InputBlock {
+	vector<T> storage;
+	std::unique_ptr<MappedFile> mapping;
+	std::span<const T> data;
+};
+
+/**
+* Loads a rank's block of an input matrix from path, or generates it if there is no path.
+* @return Whether loading succeeded, the same on every rank.
+*/
+template <typename T> bool prepare_input(InputBlock<T>& input, const std::string& path, const Block& block, int rows, int columns, uint64_t stream, const Problem& problem, const RunOptions& options, const ProcessGrid& grid) {
+	if (path.empty()) {
+		generate_block(input.storage, block, columns, problem.seed, stream);
+		input.data = input.storage;
+		return true;
+	}
+
+	// with a single rank the block is the whole matrix, so the mapped payload can be used as it is
+	if (options.map && grid.size == 1) {
+		input.mapping = std::make_unique<MappedFile>(path);
+		if (!input.mapping->is_open()) return false;
+		input.data = std::span<const T>(reinterpret_cast<const T*>(input.mapping->data() + sizeof(MatrixHeader)), block.size());
+		return true;
+	}
+
+	bool ok = read_matrix_block(path, block, rows, columns, input.storage, grid.grid);
+	input.data = input.storage;
+	return ok;
+}
+
+/**
+* Previews the corners of an input matrix on rank 0, from its file or the generator.
+*/
+template <typename T> void peek_at_input(const std::string& path, int rows, int columns, uint64_t seed, uint64_t stream) {
+	if (path.empty()) {
+		MatrixTools::peek_at_matrix_fn([&](size_t i, size_t j) { return RandomTools::uniform_at<T>(seed, stream, i * columns + j); }, rows, columns, PEEK_SIZE);
+		return;
+	}
+
+	// only the pages holding the corners are ever read
+	MappedFile file(path);
+	if (!file.is_open()) return;
+	const T* payload = reinterpret_cast<const T*>(file.data() + sizeof(MatrixHeader));
+	MatrixTools::peek_at_matrix_fn([&](size_t i, size_t j) { return payload[i * columns + j]; }, rows, columns, PEEK_SIZE);
+}
+
+template <typename T> int run_multiplication(const Problem& problem, const RunOptions& options) {
+	ProcessGrid grid = make_grid(options.distribution);
+	Layout layout = layout_of(problem, options.distribution, grid.dims, grid.coords);
+
+	if (grid.rank == 0) {
+		std::cout << "Multiplying " << problem.m << "x" << problem.k << " by " << problem.k << "x" << problem.n
+			<< " (" << ((sizeof(T) == sizeof(float)) ? "float" : "double") << "), seed " << problem.seed << std::endl;
 		std::cout << "Matrix A:" << std::endl;
-		MatrixTools::peek_at_matrix_vec_flattened<double, MATRIX_ROWS, MATRIX_COLUMNS>(matrix_a, 5);
+		peek_at_input<T>(options.load_a, problem.m, problem.k, problem.seed, STREAM_A);
 		std::cout << "Matrix B:" << std::endl;
-		MatrixTools::peek_at_matrix_vec_flattened<double, MATRIX_ROWS, MATRIX_COLUMNS>(matrix_b, 5);
+		peek_at_input<T>(options.load_b, problem.k, problem.n, problem.seed, STREAM_B);
 		std::cout << std::endl;
+
+		std::cout << "Process grid: " << grid.dims[0] << "x" << grid.dims[1] << std::endl;
+		std::cout << "Local kernel: " << Gemm::kernel_name(problem.kernel) << " (" << Gemm::SIMD_NAME << ")" << std::endl;
+	}
+
+	InputBlock<T> local_a;
+	InputBlock<T> local_b;
+	Timer input_timer;
+	bool inputs_ok = prepare_input(local_a, options.load_a, layout.a, problem.m, problem.k, STREAM_A, problem, options, grid);
+	inputs_ok = prepare_input(local_b, options.load_b, layout.b, problem.k, problem.n, STREAM_B, problem, options, grid) && inputs_ok;
+	double input_time = input_timer.stop().count();
+
+	if (!inputs_ok) {
+		if (grid.rank == 0) std::cerr << "Error reading the input matrices.\n";
+		free_grid(grid);
+		return 1;
+	}
+
+	vector<T> local_c(layout.c.size(), 0);
+	vector<T> output;
+	MultiplyStats stats;
+
+	switch (options.distribution) {
+	case Distribution::Summa:
+		if (options.pipeline) {
+			stats = multiply_summa_pipelined(problem, options, grid, layout, local_a.data, local_b.data, local_c);
+		}
+		else {
+			stats = multiply_summa(problem, options, grid, layout, local_a.data, local_b.data, local_c);
+		}
+		break;
+	case Distribution::Strassen:
+		stats = multiply_strassen(problem, options, grid, layout, local_a.data, local_b.data, local_c);
+		break;
+	case Distribution::Rows:
+	default:
+		if (options.pipeline && options.gather) {
+			stats = multiply_rows_pipelined(problem, options, grid, layout, local_a.data, local_b.data, local_c, output);
+		}
+		else {
+			stats = multiply_local(problem, layout, local_a.data, local_b.data, local_c);
+		}
+		break;
+	}
+
+	double max_input_time;
+	double max_compute_time;
+	double max_communication_time;
+	MPI_Reduce(&input_time, &max_input_time, 1, MPI_DOUBLE, MPI_MAX, 0, grid.grid);
+	MPI_Reduce(&stats.compute_time, &max_compute_time, 1, MPI_DOUBLE, MPI_MAX, 0, grid.grid);
+	MPI_Reduce(&stats.communication_time, &max_communication_time, 1, MPI_DOUBLE, MPI_MAX, 0, grid.grid);
+	double max_reference_time;
+	MPI_Reduce(&stats.reference_time, &max_reference_time, 1, MPI_DOUBLE, MPI_MAX, 0, grid.grid);
+
+	// a cheap fingerprint of the result that doesn't need it in one place
+	double local_sum = 0;
+	for (T value : local_c) local_sum += value;
+	double checksum;
+	MPI_Reduce(&local_sum, &checksum, 1, MPI_DOUBLE, MPI_SUM, 0, grid.grid);
+
+	// matrices every rank holds whole are only written by rank 0
+	Block empty = { { 0, 0 }, { 0, 0 } };
+	bool a_replicated = options.distribution == Distribution::Strassen;
+	bool b_replicated = options.distribution != Distribution::Summa;
+
+	VerifyResult verification = { 0, 0, true, 0 };
+	if (options.verify_vectors > 0) {
+		verification = verify_product<T>(problem, grid, layout, local_a.data, local_b.data, local_c, b_replicated, options.verify_vectors);
+	}
+
+	Timer output_timer;
+	bool outputs_ok = true;
+	if (!options.store_a.empty()) {
+		const Block& a_block = (a_replicated && grid.rank != 0) ? empty : layout.a;
+		outputs_ok = write_matrix_block(options.store_a, a_block, problem.m, problem.k, local_a.data.data(), grid.grid) && outputs_ok;
 	}
+	if (!options.store_b.empty()) {
+		const Block& b_block = (b_replicated && grid.rank != 0) ? empty : layout.b;
+		outputs_ok = write_matrix_block(options.store_b, b_block, problem.k, problem.n, local_b.data.data(), grid.grid) && outputs_ok;
+	}
+	if (!options.store_c.empty()) {
+		outputs_ok = write_matrix_block(options.store_c, layout.c, problem.m, problem.n, local_c.data(), grid.grid) && outputs_ok;
+	}
+	double output_time = output_timer.stop().count();
+
+	if (options.gather && !stats.gathered) gather_blocks(local_c, layout.c, output, problem.n, grid);
+
+	if (grid.rank == 0) {
+		if (!outputs_ok) std::cerr << "Error writing the matrix files.\n";
+
+		if (options.gather) {
+			std::cout << "Output:" << std::endl;
+			MatrixTools::peek_at_matrix_vec_flattened(output, problem.m, problem.n, PEEK_SIZE);
+		}
+		std::cout << "Output checksum: " << std::setprecision(12) << checksum << std::setprecision(6) << std::endl;
 
-	MPI_Bcast(matrix_b.data(), MATRIX_ROWS * MATRIX_COLUMNS, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-	
-	vector<int> sendcounts;
-	vector<int> displs;
+		double flops = 2.0 * problem.m * problem.n * problem.k;
+		std::cout << "Slowest rank took " << max_input_time << " seconds to " << ((options.load_a.empty() && options.load_b.empty()) ? "generate" : "load") << " its blocks." << std::endl;
+		std::cout << "Slowest rank took " << max_compute_time << " seconds to compute." << std::endl;
+		std::cout << "Slowest rank spent " << max_communication_time << " seconds communicating." << std::endl;
+		if (output_time > 0.001) std::cout << "Writing the matrix files took " << output_time << " seconds." << std::endl;
+		std::cout << "Achieved " << flops / max_compute_time / 1e9 << " GFLOP/s." << std::endl;
 
-	int displ = 0;
-	int extra_rows = MATRIX_ROWS % world_size;
-	for (int i = 0; i < world_size; i++) {
-		int rows = MATRIX_ROWS / world_size;
-		if (i < extra_rows) {
-			rows++;
+		if (options.verify_vectors > 0) {
+			std::cout << "Freivalds check with " << options.verify_vectors << " random vectors: relative residual " << verification.residual
+				<< " against a tolerance of " << verification.tolerance << ", " << (verification.passed ? "passed" : "FAILED") << "." << std::endl;
+			std::cout << "Verification took " << verification.time << " seconds." << std::endl;
 		}
 
-		sendcounts.push_back(rows * MATRIX_COLUMNS);
-		displs.push_back(displ);
-		displ += rows * MATRIX_COLUMNS;
+		if (stats.reference_time > 0) {
+			std::cout << "Slowest rank took " << max_reference_time << " seconds on the classical path, a speedup of "
+				<< max_reference_time / max_compute_time << "x." << std::endl;
+			std::cout << "Largest difference from the classical result: " << stats.reference_error << " (relative to its largest element)" << std::endl;
+		}
+	}
+
+	free_grid(grid);
+	return (outputs_ok && verification.passed) ? 0 : 1;
+}
+
+ProcessGrid make_grid(Distribution distribution) {
+	ProcessGrid grid;
+	MPI_Comm_size(MPI_COMM_WORLD, &grid.size);
+
+	grid.dims[0] = grid.size;
+	grid.dims[1] = 1;
+	if (distribution == Distribution::Summa) {
+		grid.dims[0] = grid.dims[1] = 0;
+		MPI_Dims_create(grid.size, 2, grid.dims);
 	}
 
-	vector<double> local_matrix_a(sendcounts[rank]);
-	MPI_Scatterv(matrix_a.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, local_matrix_a.data(), sendcounts[rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	// no reordering, so rank 0 of the grid is still rank 0 of the world
+	int periods[2] = { 0, 0 };
+	MPI_Cart_create(MPI_COMM_WORLD, 2, grid.dims, periods, 0, &grid.grid);
+	MPI_Comm_rank(grid.grid, &grid.rank);
+	MPI_Cart_coords(grid.grid, grid.rank, 2, grid.coords);
 
-	vector<double> local_output(sendcounts[rank], 0);
+	int keep_columns[2] = { 0, 1 };
+	int keep_rows[2] = { 1, 0 };
+	MPI_Cart_sub(grid.grid, keep_columns, &grid.row_comm);
+	MPI_Cart_sub(grid.grid, keep_rows, &grid.column_comm);
 
-	//std::cout << "Rank " << rank << " has " << sendcounts[rank] / MATRIX_COLUMNS << " rows." << std::endl;
+	return grid;
+}
 
-	for (int i = 0; i < sendcounts[rank] / MATRIX_COLUMNS; i++) {
-		for (int j = 0; j < MATRIX_COLUMNS; j++) {
-			for (int k = 0; k < MATRIX_COLUMNS; k++) {
-				if (i * MATRIX_COLUMNS + j >= sendcounts[rank]) {
-					std::cout << 1 << std::endl;
-				}
-				if (i * MATRIX_COLUMNS + k >= sendcounts[rank]) {
-					std::cout << 2 << std::endl;
-				}
-				if (i * MATRIX_COLUMNS + j >= MATRIX_ROWS * MATRIX_COLUMNS) {
-					std::cout << 3 << std::endl;
-				}
-				local_output[i * MATRIX_COLUMNS + j] += local_matrix_a[i * MATRIX_COLUMNS + k] * matrix_b[k * MATRIX_COLUMNS + j];
+void free_grid(ProcessGrid& grid) {
+	MPI_Comm_free(&grid.row_comm);
+	MPI_Comm_free(&grid.column_comm);
+	MPI_Comm_free(&grid.grid);
+}
+
+/**
+* Which parts of A, B and C the rank at coords holds.
+* A and C are split into blocks over the grid. With the row distribution B is held whole by everyone,
+* with SUMMA it's split the same way as the others. Strassen-Winograd needs all of A too.
+*/
+Layout layout_of(const Problem& problem, Distribution distribution, const int dims[2], const int coords[2]) {
+	Layout layout;
+	layout.a = { block_range(problem.m, dims[0], coords[0]), block_range(problem.k, dims[1], coords[1]) };
+	layout.c = { block_range(problem.m, dims[0], coords[0]), block_range(problem.n, dims[1], coords[1]) };
+
+	if (distribution == Distribution::Summa) {
+		layout.b = { block_range(problem.k, dims[0], coords[0]), block_range(problem.n, dims[1], coords[1]) };
+	}
+	else {
+		layout.b = { { 0, problem.k }, { 0, problem.n } };
+	}
+
+	if (distribution == Distribution::Strassen) {
+		layout.a = { { 0, problem.m }, { 0, problem.k } };
+	}
+
+	return layout;
+}
+
+/**
+* Collects every rank's block of a matrix into one rows × columns matrix on rank 0.
+* Only rank 0 allocates the full matrix, and each block goes straight into its place in it.
+*/
+template <typename T> void gather_blocks(const vector<T>& local, const Block& block, vector<T>& matrix, int columns, const ProcessGrid& grid) {
+	vector<Block> blocks(grid.size);
+	MPI_Gather(&block, sizeof(Block), MPI_BYTE, blocks.data(), sizeof(Block), MPI_BYTE, 0, grid.grid);
+
+	// counts are in whole rows of a block, so large matrices don't overflow MPI's int counts
+	vector<MPI_Request> requests;
+	vector<MPI_Datatype> places;
+	if (grid.rank == 0) {
+		size_t rows = 0;
+		for (const Block& b : blocks) rows = std::max(rows, (size_t)b.rows.end());
+		matrix.resize(rows * columns);
+
+		for (int i = 0; i < grid.size; i++) {
+			if (blocks[i].size() == 0) continue;
+			places.emplace_back();
+			MPI_Type_vector(blocks[i].rows.count, blocks[i].columns.count, columns, mpi_datatype<T>(), &places.back());
+			MPI_Type_commit(&places.back());
+			requests.emplace_back();
+			T* corner = matrix.data() + (size_t)blocks[i].rows.start * columns + blocks[i].columns.start;
+			MPI_Irecv(corner, 1, places.back(), i, 0, grid.grid, &requests.back());
+		}
+	}
+
+	if (block.size() > 0) {
+		MPI_Datatype row;
+		MPI_Type_contiguous(block.columns.count, mpi_datatype<T>(), &row);
+		MPI_Type_commit(&row);
+		MPI_Send(local.data(), block.rows.count, row, 0, 0, grid.grid);
+		MPI_Type_free(&row);
+	}
+
+	MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+	for (MPI_Datatype& place : places) MPI_Type_free(&place);
+}
+
+/**
+* Row distribution: every rank already has its rows of A and all of B, so there is nothing to communicate.
+*/
+template <typename T> MultiplyStats multiply_local(const Problem& problem, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c) {
+	MultiplyStats stats;
+
+	Timer compute_timer;
+	Gemm::gemm(problem.kernel, layout.c.rows.count, problem.n, problem.k,
+		local_a.data(), problem.k,
+		local_b.data(), problem.n,
+		local_c.data(), problem.n);
+	stats.compute_time = compute_timer.stop().count();
+
+	return stats;
+}
+
+/**
+* Row distribution, pipelined: the output is computed a chunk of rows at a time, and each chunk is sent
+* to rank 0 with MPI_Igatherv while the next one is computed, so the gather is done soon after the multiply.
+*/
+template <typename T> MultiplyStats multiply_rows_pipelined(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c, vector<T>& output) {
+	MultiplyStats stats;
+	stats.gathered = true;
+
+	int chunk_rows = (options.chunk > 0) ? options.chunk : PIPELINE_ROWS;
+	int n = problem.n;
+	if (grid.rank == 0) output.resize((size_t)problem.m * n);
+
+	// everyone takes part in every gather, so the count is set by the rank with the most rows
+	int most_rows = block_range(problem.m, grid.size, 0).count;
+	int chunks = (most_rows + chunk_rows - 1) / chunk_rows;
+
+	// counts are in whole rows, so large matrices don't overflow MPI's int counts
+	MPI_Datatype row;
+	MPI_Type_contiguous(n, mpi_datatype<T>(), &row);
+	MPI_Type_commit(&row);
+
+	vector<MPI_Request> requests(chunks, MPI_REQUEST_NULL);
+	vector<vector<int>> counts(chunks, vector<int>(grid.size));
+	vector<vector<int>> displs(chunks, vector<int>(grid.size));
+
+	for (int chunk = 0; chunk < chunks; chunk++) {
+		int first = std::min(chunk * chunk_rows, layout.c.rows.count);
+		int rows = std::min(chunk_rows, layout.c.rows.count - first);
+
+		Timer compute_timer;
+		if (rows > 0) {
+			Gemm::gemm(problem.kernel, rows, n, problem.k,
+				local_a.data() + (size_t)first * problem.k, problem.k,
+				local_b.data(), n,
+				local_c.data() + (size_t)first * n, n);
+		}
+		stats.compute_time += compute_timer.stop().count();
+
+		Timer communication_timer;
+		for (int i = 0; i < grid.size; i++) {
+			BlockRange slab = block_range(problem.m, grid.size, i);
+			int slab_first = std::min(chunk * chunk_rows, slab.count);
+			counts[chunk][i] = std::min(chunk_rows, slab.count - slab_first);
+			displs[chunk][i] = slab.start + slab_first;
+		}
+		MPI_Igatherv(local_c.data() + (size_t)first * n, rows, row,
+			output.data(), counts[chunk].data(), displs[chunk].data(), row, 0, grid.grid, &requests[chunk]);
+
+		// gives the library a chance to move the earlier chunks along
+		int done;
+		MPI_Testall(chunk + 1, requests.data(), &done, MPI_STATUSES_IGNORE);
+		stats.communication_time += communication_timer.stop().count();
+	}
+
+	Timer communication_timer;
+	MPI_Waitall(chunks, requests.data(), MPI_STATUSES_IGNORE);
+	stats.communication_time += communication_timer.stop().count();
+	MPI_Type_free(&row);
+
+	return stats;
+}
+
+/**
+* 2D distribution (SUMMA): A, B and C are split into blocks over a process grid.
+* For every panel of the shared dimension, the owners broadcast their piece of A along
+* their grid row and their piece of B along their grid column, and everyone does a rank-k update.
+* Each rank only ever holds O(N²/P) of each matrix, and moves O(N²/√P) per multiply.
+*/
+template <typename T> MultiplyStats multiply_summa(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c) {
+	MultiplyStats stats;
+
+	int shared = problem.k;
+	int local_m = layout.c.rows.count;
+	int local_n = layout.c.columns.count;
+	int local_k = layout.a.columns.count;
+	int panel_width = (options.chunk > 0) ? options.chunk : SUMMA_PANEL_WIDTH;
+
+	vector<T> a_panel((size_t)local_m * panel_width);
+	vector<T> b_panel((size_t)panel_width * local_n);
+
+	for (int k = 0; k < shared;) {
+		// a panel never straddles two owners, so it's one broadcast along each direction
+		int a_owner = block_owner(shared, grid.dims[1], k);
+		int b_owner = block_owner(shared, grid.dims[0], k);
+		BlockRange a_block = block_range(shared, grid.dims[1], a_owner);
+		BlockRange b_block = block_range(shared, grid.dims[0], b_owner);
+		int width = std::min({ panel_width, a_block.end() - k, b_block.end() - k });
+
+		Timer communication_timer;
+		if (grid.coords[1] == a_owner) {
+			for (int i = 0; i < local_m; i++) {
+				const T* source = local_a.data() + (size_t)i * local_k + (k - a_block.start);
+				std::copy(source, source + width, a_panel.begin() + (size_t)i * width);
 			}
 		}
+		// the owner only ever sends from its block, never writes to it
+		T* b_source = (grid.coords[0] == b_owner) ? const_cast<T*>(local_b.data()) + (size_t)(k - b_block.start) * local_n : b_panel.data();
+
+		MPI_Bcast(a_panel.data(), local_m * width, mpi_datatype<T>(), a_owner, grid.row_comm);
+		MPI_Bcast(b_source, width * local_n, mpi_datatype<T>(), b_owner, grid.column_comm);
+		stats.communication_time += communication_timer.stop().count();
+
+		Timer compute_timer;
+		Gemm::gemm(problem.kernel, local_m, local_n, width, a_panel.data(), width, b_source, local_n, local_c.data(), local_n);
+		stats.compute_time += compute_timer.stop().count();
+
+		k += width;
 	}
-	vector<double> output(MATRIX_ROWS * MATRIX_COLUMNS);
-	MPI_Gatherv(local_output.data(), sendcounts[rank], MPI_DOUBLE, output.data(), sendcounts.data(), displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-	if (rank == 0) {
-		std::cout << "Output:" << std::endl;
-		MatrixTools::peek_at_matrix_vec_flattened<double, MATRIX_ROWS, MATRIX_COLUMNS>(output, 5);
+	return stats;
+}
+
+/**
+* SUMMA, pipelined: the panels are broadcast with MPI_Ibcast into two sets of buffers, so the next panel
+* is already on its way while the current one is multiplied. Each multiply is done in a few pieces,
+* testing the broadcasts in between, since most MPI libraries only move nonblocking collectives along inside MPI calls.
+*/
+template <typename T> MultiplyStats multiply_summa_pipelined(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> local_a, std::span<const T> local_b, vector<T>& local_c) {
+	MultiplyStats stats;
+
+	int shared = problem.k;
+	int local_m = layout.c.rows.count;
+	int local_n = layout.c.columns.count;
+	int local_k = layout.a.columns.count;
+	int panel_width = (options.chunk > 0) ? options.chunk : SUMMA_PANEL_WIDTH;
+
+	struct Panel {
+		int k;
+		int width;
+		int a_owner;
+		int b_owner;
+	};
+
+	// the same panels as the blocking version, worked out up front so the next one can be started early
+	vector<Panel> panels;
+	for (int k = 0; k < shared;) {
+		int a_owner = block_owner(shared, grid.dims[1], k);
+		int b_owner = block_owner(shared, grid.dims[0], k);
+		int width = std::min({ panel_width, block_range(shared, grid.dims[1], a_owner).end() - k, block_range(shared, grid.dims[0], b_owner).end() - k });
+		panels.push_back({ k, width, a_owner, b_owner });
+		k += width;
+	}
+
+	vector<T> a_panels[2] = { vector<T>((size_t)local_m * panel_width), vector<T>((size_t)local_m * panel_width) };
+	vector<T> b_panels[2] = { vector<T>((size_t)panel_width * local_n), vector<T>((size_t)panel_width * local_n) };
+	T* b_sources[2];
+	MPI_Request requests[2][2] = { { MPI_REQUEST_NULL, MPI_REQUEST_NULL }, { MPI_REQUEST_NULL, MPI_REQUEST_NULL } };
+
+	auto start = [&](int index) {
+		const Panel& panel = panels[index];
+		int buffer = index % 2;
+		T* a_panel = a_panels[buffer].data();
+
+		if (grid.coords[1] == panel.a_owner) {
+			int a_start = block_range(shared, grid.dims[1], panel.a_owner).start;
+			for (int i = 0; i < local_m; i++) {
+				const T* source = local_a.data() + (size_t)i * local_k + (panel.k - a_start);
+				std::copy(source, source + panel.width, a_panel + (size_t)i * panel.width);
+			}
+		}
+		int b_start = block_range(shared, grid.dims[0], panel.b_owner).start;
+		b_sources[buffer] = (grid.coords[0] == panel.b_owner) ? const_cast<T*>(local_b.data()) + (size_t)(panel.k - b_start) * local_n : b_panels[buffer].data();
+
+		MPI_Ibcast(a_panel, local_m * panel.width, mpi_datatype<T>(), panel.a_owner, grid.row_comm, &requests[buffer][0]);
+		MPI_Ibcast(b_sources[buffer], panel.width * local_n, mpi_datatype<T>(), panel.b_owner, grid.column_comm, &requests[buffer][1]);
+	};
+
+	Timer start_timer;
+	if (!panels.empty()) start(0);
+	stats.communication_time += start_timer.stop().count();
+
+	int piece_rows = std::max(1, (local_m + PIPELINE_POLLS - 1) / PIPELINE_POLLS);
+	for (int index = 0; index < (int)panels.size(); index++) {
+		int buffer = index % 2;
+		int next = 1 - buffer;
+		bool has_next = index + 1 < (int)panels.size();
+
+		// the buffers of the next panel were last used by the previous one, which is finished
+		Timer communication_timer;
+		MPI_Waitall(2, requests[buffer], MPI_STATUSES_IGNORE);
+		if (has_next) start(index + 1);
+		stats.communication_time += communication_timer.stop().count();
+
+		int width = panels[index].width;
+		for (int first = 0; first < local_m; first += piece_rows) {
+			int rows = std::min(piece_rows, local_m - first);
+
+			Timer compute_timer;
+			Gemm::gemm(problem.kernel, rows, local_n, width,
+				a_panels[buffer].data() + (size_t)first * width, width,
+				b_sources[buffer], local_n,
+				local_c.data() + (size_t)first * local_n, local_n);
+			stats.compute_time += compute_timer.stop().count();
+
+			if (has_next) {
+				Timer test_timer;
+				int done;
+				MPI_Testall(2, requests[next], &done, MPI_STATUSES_IGNORE);
+				stats.communication_time += test_timer.stop().count();
+			}
+		}
+	}
+
+	return stats;
+}
+
+/**
+* Copies a rows × columns matrix into the top left corner of a zeroed padded_rows × padded_columns one,
+* unless the sizes already match.
+* @return A view of whichever of the two has the padded size.
+*/
+template <typename T> Strassen::ConstView<T> pad_matrix(std::span<const T> matrix, int rows, int columns, int padded_rows, int padded_columns, vector<T>& padded) {
+	if (rows == padded_rows && columns == padded_columns) {
+		return { matrix.data(), rows, columns, columns };
+	}
+
+	padded.assign((size_t)padded_rows * padded_columns, 0);
+	for (int i = 0; i < rows; i++) {
+		std::copy(matrix.data() + (size_t)i * columns, matrix.data() + (size_t)(i + 1) * columns, padded.begin() + (size_t)i * padded_columns);
+	}
+	return { padded.data(), padded_rows, padded_columns, padded_columns };
+}
+
+/**
+* MPI_SUM for datatypes made of several T, which the built in operations don't take.
+*/
+template <typename T> void sum_elements(void* in, void* inout, int* count, MPI_Datatype* type) {
+	int bytes;
+	MPI_Type_size(*type, &bytes);
+	size_t elements = (size_t)*count * (bytes / sizeof(T));
+	const T* from = static_cast<const T*>(in);
+	T* to = static_cast<T*>(inout);
+	for (size_t i = 0; i < elements; i++) to[i] += from[i];
+}
+
+/**
+* Strassen-Winograd: every rank holds all of A and B. The 7^d products of the top d levels of the recursion
+* are shared out over the ranks, with d the smallest depth that gives everyone at least one.
+* Each rank forms the operands of its products from the quadrants of A and B, runs the rest of the recursion
+* on them locally, and adds them into the quadrants of C they belong to.
+* A single reduce-scatter then sums the contributions and leaves each rank with its slab of rows of C.
+* Every rank keeps a whole padded C for its contributions, so this saves arithmetic, not memory or traffic.
+* The classical product of the same slab is computed afterwards to compare the time and the result against.
+*/
+template <typename T> MultiplyStats multiply_strassen(const Problem& problem, const RunOptions& options, const ProcessGrid& grid, const Layout& layout, std::span<const T> a, std::span<const T> b, vector<T>& local_c) {
+	MultiplyStats stats;
+
+	int levels = Strassen::levels_for(problem.m, problem.k, problem.n, options.strassen_cutoff);
+	int spread = 0;
+	int products = 1;
+	while (spread < levels && products < grid.size) {
+		spread++;
+		products *= Strassen::PRODUCTS;
+	}
+
+	if (grid.rank == 0) {
+		std::cout << "Strassen-Winograd: " << levels << " levels above a cutoff of " << options.strassen_cutoff
+			<< ", the top " << spread << " shared out as " << products << " products." << std::endl;
+	}
+
+	Timer compute_timer;
+
+	// every level halves each dimension, so they are rounded up to a multiple of 2^levels
+	int align = 1 << levels;
+	int m = (problem.m + align - 1) / align * align;
+	int k = (problem.k + align - 1) / align * align;
+	int n = (problem.n + align - 1) / align * align;
+
+	vector<T> padded_a;
+	vector<T> padded_b;
+	Strassen::ConstView<T> full_a = pad_matrix(a, problem.m, problem.k, m, k, padded_a);
+	Strassen::ConstView<T> full_b = pad_matrix(b, problem.k, problem.n, k, n, padded_b);
+
+	// operands at each shared out level, then the product, then what the local recursion needs
+	int leaf_m = m >> spread;
+	int leaf_k = k >> spread;
+	int leaf_n = n >> spread;
+	size_t workspace_size = (size_t)leaf_m * leaf_n + Strassen::workspace_size(leaf_m, leaf_k, leaf_n, levels - spread);
+	for (int level = 1; level <= spread; level++) {
+		workspace_size += (size_t)(m >> level) * (k >> level) + (size_t)(k >> level) * (n >> level);
+	}
+	Strassen::Workspace<T> workspace(workspace_size);
+
+	vector<T> contributions((size_t)m * n, 0);
+	Strassen::View<T> full_c = { contributions.data(), m, n, n };
+
+	BlockRange mine = block_range(products, grid.size, grid.rank);
+	for (int product = mine.start; product < mine.end(); product++) {
+		size_t mark = workspace.mark();
+
+		// the base 7 digits of the product index pick one product at each shared out level, most significant first
+		vector<int> path(spread);
+		for (int level = spread - 1, rest = product; level >= 0; level--, rest /= Strassen::PRODUCTS) {
+			path[level] = rest % Strassen::PRODUCTS;
+		}
+
+		Strassen::ConstView<T> left = full_a;
+		Strassen::ConstView<T> right = full_b;
+		for (int level = 0; level < spread; level++) {
+			Strassen::View<T> next_left = workspace.take(left.rows / 2, left.columns / 2);
+			Strassen::View<T> next_right = workspace.take(right.rows / 2, right.columns / 2);
+			Strassen::combine<T>(next_left, left, Strassen::LEFT[path[level]]);
+			Strassen::combine<T>(next_right, right, Strassen::RIGHT[path[level]]);
+			left = next_left;
+			right = next_right;
+		}
+
+		// without anything shared out there is just the one product, and it is C
+		if (spread == 0) {
+			Strassen::multiply<T>(problem.kernel, left, right, full_c, levels, workspace);
+			continue;
+		}
+
+		Strassen::View<T> result = workspace.take(leaf_m, leaf_n);
+		Strassen::multiply<T>(problem.kernel, left, right, result, levels - spread, workspace);
+
+		// the product ends up in every block of C whose quadrant at each level uses it at that level
+		int blocks = 1 << (2 * spread);
+		for (int block = 0; block < blocks; block++) {
+			int coefficient = 1;
+			int row = 0;
+			int column = 0;
+			for (int level = 0; level < spread; level++) {
+				int quadrant = (block >> (2 * (spread - 1 - level))) & 3;
+				coefficient *= Strassen::OUTPUT[quadrant][path[level]];
+				row = row * 2 + quadrant / 2;
+				column = column * 2 + quadrant % 2;
+			}
+			if (coefficient != 0) {
+				Strassen::accumulate<T>(full_c.block(row * leaf_m, column * leaf_n, leaf_m, leaf_n), result, coefficient);
+			}
+		}
+
+		workspace.release(mark);
+	}
+
+	// drop the padding, moving rows forward in place
+	if (n != problem.n) {
+		for (int i = 1; i < problem.m; i++) {
+			std::copy(contributions.begin() + (size_t)i * n, contributions.begin() + (size_t)i * n + problem.n, contributions.begin() + (size_t)i * problem.n);
+		}
+	}
+	stats.compute_time = compute_timer.stop().count();
+
+	Timer communication_timer;
+	// counts are in whole rows, so large matrices don't overflow MPI's int counts
+	MPI_Datatype row;
+	MPI_Type_contiguous(problem.n, mpi_datatype<T>(), &row);
+	MPI_Type_commit(&row);
+	vector<int> counts(grid.size);
+	for (int i = 0; i < grid.size; i++) {
+		counts[i] = block_range(problem.m, grid.size, i).count;
+	}
+	MPI_Op sum;
+	MPI_Op_create(sum_elements<T>, 1, &sum);
+	MPI_Reduce_scatter(contributions.data(), local_c.data(), counts.data(), row, sum, grid.grid);
+	MPI_Op_free(&sum);
+	MPI_Type_free(&row);
+	stats.communication_time = communication_timer.stop().count();
+
+	vector<T> reference(layout.c.size(), 0);
+	Timer reference_timer;
+	Gemm::gemm(problem.kernel, layout.c.rows.count, problem.n, problem.k,
+		a.data() + (size_t)layout.c.rows.start * problem.k, problem.k,
+		b.data(), problem.n,
+		reference.data(), problem.n);
+	stats.reference_time = reference_timer.stop().count();
+
+	double error[2] = { 0, 0 }; // largest difference, largest element
+	for (size_t i = 0; i < reference.size(); i++) {
+		error[0] = std::max(error[0], (double)std::abs(local_c[i] - reference[i]));
+		error[1] = std::max(error[1], (double)std::abs(reference[i]));
 	}
+	MPI_Allreduce(MPI_IN_PLACE, error, 2, MPI_DOUBLE, MPI_MAX, grid.grid);
+	stats.reference_error = (error[1] > 0) ? error[0] / error[1] : 0;
 
-	return 0;
-}
\ No newline at end of file
+	return stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <utility>
+
+#include "gemm.h"
+
+/**
+* Kernels for small square products whose size is known at compile time, for batches of many of them.
+* Packing and cache blocking only pay off for big matrices, these just keep a row of C in registers.
+*/
+namespace Gemm {
+	/**
+	* Calls body(std::integral_constant<int, I>()) for I = 0 ... COUNT - 1, written out one after another.
+	*/
+	template <int COUNT, typename F> inline void unroll(F&& body) {
+		[&]<int... I>(std::integer_sequence<int, I...>) {
+			(body(std::integral_constant<int, I>()), ...);
+		}(std::make_integer_sequence<int, COUNT>());
+	}
+
+	/**
+	* C += A * B for N×N matrices stored contiguously, row-major.
+	* A row of C stays in N / WIDTH registers for the whole inner loop, and the loop over them is unrolled.
+	*/
+	template <typename T, int N> void small_gemm(const T* a, const T* b, T* c) {
+		using V = Vec<T>;
+
+		if constexpr (N % V::WIDTH == 0) {
+			constexpr int VECTORS = N / V::WIDTH;
+			for (int i = 0; i < N; i++) {
+				V acc[VECTORS];
+				unroll<VECTORS>([&](auto v) { acc[v] = V::load(c + i * N + v * V::WIDTH); });
+
+				for (int p = 0; p < N; p++) {
+					V a_value = V::broadcast(a[i * N + p]);
+					const T* b_row = b + p * N;
+					unroll<VECTORS>([&](auto v) { acc[v] = V::fmadd(a_value, V::load(b_row + v * V::WIDTH), acc[v]); });
+				}
+
+				unroll<VECTORS>([&](auto v) { acc[v].store(c + i * N + v * V::WIDTH); });
+			}
+		}
+		else {
+			// narrower than a register, the compiler gets to vectorize the row itself
+			for (int i = 0; i < N; i++) {
+				T row[N];
+				unroll<N>([&](auto j) { row[j] = c[i * N + j]; });
+				for (int p = 0; p < N; p++) {
+					T a_value = a[i * N + p];
+					unroll<N>([&](auto j) { row[j] += a_value * b[p * N + j]; });
+				}
+				unroll<N>([&](auto j) { c[i * N + j] = row[j]; });
+			}
+		}
+	}
+
+	template <typename T> using SmallKernel = void (*)(const T* a, const T* b, T* c);
+
+	/**
+	* @return The specialized kernel for n×n products, or nullptr if there isn't one.
+	*/
+	template <typename T> SmallKernel<T> small_kernel(int n) {
+		switch (n) {
+		case 4: return small_gemm<T, 4>;
+		case 8: return small_gemm<T, 8>;
+		case 16: return small_gemm<T, 16>;
+		case 32: return small_gemm<T, 32>;
+		case 64: return small_gemm<T, 64>;
+		default: return nullptr;
+		}
+	}
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "gemm.h"
+#include "../thread_pool.h"
+
+/**
+* Strassen-Winograd multiplication: each level replaces one product of two halved matrices
+* by 7 half-size products and 15 additions, instead of 8 products.
+* Matrices are row-major views into larger buffers like in Gemm, but these compute C = A * B, not C += A * B.
+*/
+namespace Strassen {
+	constexpr int PRODUCTS = 7;
+
+	// Quadrants are numbered 0 = 11, 1 = 12, 2 = 21, 3 = 22.
+	// Product i is (sum over q of LEFT[i][q] * A_q) * (sum over q of RIGHT[i][q] * B_q),
+	// and quadrant q of C is the sum over i of OUTPUT[q][i] * P_i.
+	constexpr int LEFT[PRODUCTS][4] = {
+		{ 1, 0, 0, 0 },		// A11
+		{ 0, 1, 0, 0 },		// A12
+		{ 1, 1, -1, -1 },	// S4 = A12 - S2
+		{ 0, 0, 0, 1 },		// A22
+		{ 0, 0, 1, 1 },		// S1 = A21 + A22
+		{ -1, 0, 1, 1 },	// S2 = S1 - A11
+		{ 1, 0, -1, 0 },	// S3 = A11 - A21
+	};
+	constexpr int RIGHT[PRODUCTS][4] = {
+		{ 1, 0, 0, 0 },		// B11
+		{ 0, 0, 1, 0 },		// B21
+		{ 0, 0, 0, 1 },		// B22
+		{ 1, -1, -1, 1 },	// T4 = T2 - B21
+		{ -1, 1, 0, 0 },	// T1 = B12 - B11
+		{ 1, -1, 0, 1 },	// T2 = B22 - T1
+		{ 0, -1, 0, 1 },	// T3 = B22 - B12
+	};
+	constexpr int OUTPUT[4][PRODUCTS] = {
+		{ 1, 1, 0, 0, 0, 0, 0 },
+		{ 1, 0, 1, 0, 1, 1, 0 },
+		{ 1, 0, 0, -1, 0, 1, 1 },
+		{ 1, 0, 0, 0, 1, 1, 1 },
+	};
+
+	template <typename T> struct View {
+		T* data;
+		int rows;
+		int columns;
+		int stride;
+
+		T* row(int i) const { return data + (size_t)i * stride; }
+
+		/**
+		* @return The view of quadrant q. Only valid if rows and columns are even.
+		*/
+		View quadrant(int q) const {
+			int half_rows = rows / 2;
+			int half_columns = columns / 2;
+			return { row((q / 2) * half_rows) + (q % 2) * half_columns, half_rows, half_columns, stride };
+		}
+
+		/**
+		* @return The view of the rows × columns block starting at (first_row, first_column).
+		*/
+		View block(int first_row, int first_column, int block_rows, int block_columns) const {
+			return { row(first_row) + first_column, block_rows, block_columns, stride };
+		}
+
+		operator View<const T>() const requires (!std::is_const_v<T>) { return { data, rows, columns, stride }; }
+	};
+
+	template <typename T> using ConstView = View<const std::type_identity_t<T>>;
+
+	/**
+	* Hands out temporaries from one buffer allocated up front, in a stack-like fashion.
+	* A recursion level takes what it needs and gives it all back with release(mark()) before returning.
+	*/
+	template <typename T> class Workspace {
+	public:
+		explicit Workspace(size_t size) : m_buffer(size) {}
+
+		View<T> take(int rows, int columns) {
+			View<T> view = { m_buffer.data() + m_top, rows, columns, columns };
+			m_top += (size_t)rows * columns;
+			return view;
+		}
+
+		size_t mark() const { return m_top; }
+		void release(size_t mark) { m_top = mark; }
+
+	private:
+		std::vector<T> m_buffer;
+		size_t m_top = 0;
+	};
+
+	/**
+	* @return How many times m, k and n can be halved before the smallest of them reaches cutoff.
+	*/
+	inline int levels_for(int m, int k, int n, int cutoff) {
+		int smallest = std::min({ m, k, n });
+		int levels = 0;
+		while (cutoff > 0 && (smallest >> levels) > cutoff) levels++;
+		return levels;
+	}
+
+	/**
+	* @return The size of the workspace multiply() needs for an m×k by k×n product with the given number of levels.
+	*/
+	inline size_t workspace_size(int m, int k, int n, int levels) {
+		size_t size = 0;
+		for (int level = 1; level <= levels; level++) {
+			size_t hm = m >> level;
+			size_t hk = k >> level;
+			size_t hn = n >> level;
+			size += hm * hk + hk * hn + hm * hn;
+		}
+		return size;
+	}
+
+	/**
+	* target = x + sign * y, element by element. target may be the same as x or y.
+	*/
+	template <typename T> void add(View<T> target, ConstView<T> x, ConstView<T> y, T sign) {
+		ThreadPool::instance().parallel_for(0, target.rows, [&](long long first, long long last) {
+			for (int i = (int)first; i < last; i++) {
+				T* out = target.row(i);
+				const T* x_row = x.row(i);
+				const T* y_row = y.row(i);
+				for (int j = 0; j < target.columns; j++) {
+					out[j] = x_row[j] + sign * y_row[j];
+				}
+			}
+		});
+	}
+
+	/**
+	* target += coefficient * x
+	*/
+	template <typename T> void accumulate(View<T> target, ConstView<T> x, int coefficient) {
+		add<T>(target, target, x, (T)coefficient);
+	}
+
+	/**
+	* target = sum over q of coefficients[q] * (quadrant q of source)
+	*/
+	template <typename T> void combine(View<T> target, ConstView<T> source, const int coefficients[4]) {
+		ThreadPool::instance().parallel_for(0, target.rows, [&](long long first, long long last) {
+			for (int i = (int)first; i < last; i++) {
+				T* out = target.row(i);
+				std::fill(out, out + target.columns, (T)0);
+				for (int q = 0; q < 4; q++) {
+					if (coefficients[q] == 0) continue;
+					const T* in = source.quadrant(q).row(i);
+					T c = (T)coefficients[q];
+					for (int j = 0; j < target.columns; j++) {
+						out[j] += c * in[j];
+					}
+				}
+			}
+		});
+	}
+
+	/**
+	* C = A * B, recursing the given number of levels before handing the leaves to the local kernel.
+	* Every dimension has to be divisible by 2^levels, and workspace needs workspace_size() free.
+	*
+	* Uses the Winograd ordering with three temporaries, X (A sized), Y (B sized) and Z (C sized),
+	* and the quadrants of C themselves as scratch.
+	*/
+	template <typename T> void multiply(Gemm::Kernel kernel, ConstView<T> a, ConstView<T> b, View<T> c, int levels, Workspace<T>& workspace) {
+		if (levels == 0) {
+			ThreadPool::instance().parallel_for(0, c.rows, [&](long long first, long long last) {
+				for (int i = (int)first; i < last; i++) {
+					std::fill(c.row(i), c.row(i) + c.columns, (T)0);
+				}
+			});
+			Gemm::gemm(kernel, c.rows, c.columns, a.columns, a.data, a.stride, b.data, b.stride, c.data, c.stride);
+			return;
+		}
+
+		size_t mark = workspace.mark();
+		View<T> x = workspace.take(a.rows / 2, a.columns / 2);
+		View<T> y = workspace.take(b.rows / 2, b.columns / 2);
+		View<T> z = workspace.take(c.rows / 2, c.columns / 2);
+
+		ConstView<T> a11 = a.quadrant(0), a12 = a.quadrant(1), a21 = a.quadrant(2), a22 = a.quadrant(3);
+		ConstView<T> b11 = b.quadrant(0), b12 = b.quadrant(1), b21 = b.quadrant(2), b22 = b.quadrant(3);
+		View<T> c11 = c.quadrant(0), c12 = c.quadrant(1), c21 = c.quadrant(2), c22 = c.quadrant(3);
+
+		add<T>(x, a11, a21, -1);							// S3
+		add<T>(y, b22, b12, -1);							// T3
+		multiply<T>(kernel, x, y, c21, levels - 1, workspace);	// P7
+		add<T>(x, a21, a22, 1);								// S1
+		add<T>(y, b12, b11, -1);							// T1
+		multiply<T>(kernel, x, y, c22, levels - 1, workspace);	// P5
+		add<T>(x, x, a11, -1);								// S2
+		add<T>(y, b22, y, -1);								// T2
+		multiply<T>(kernel, x, y, c12, levels - 1, workspace);	// P6
+		add<T>(x, a12, x, -1);								// S4
+		multiply<T>(kernel, x, b22, c11, levels - 1, workspace);	// P3
+		multiply<T>(kernel, a11, b11, z, levels - 1, workspace);	// P1
+
+		add<T>(c12, c12, z, 1);		// U2 = P1 + P6
+		add<T>(c21, c21, c12, 1);	// U3 = U2 + P7
+		add<T>(c12, c12, c22, 1);	// U4 = U2 + P5
+		add<T>(c12, c12, c11, 1);	// C12 = U4 + P3
+		add<T>(c22, c22, c21, 1);	// C22 = U3 + P5
+		add<T>(y, y, b21, -1);								// T4
+		multiply<T>(kernel, a22, y, c11, levels - 1, workspace);	// P4
+		add<T>(c21, c21, c11, -1);	// C21 = U3 - P4
+		multiply<T>(kernel, a12, b21, c11, levels - 1, workspace);	// P2
+		add<T>(c11, c11, z, 1);		// C11 = P1 + P2
+
+		workspace.release(mark);
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "matrix.h"
+#include "../thread_pool.h"
+
+#include <mpi.h>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <vector>
+
+// first stream of RandomTools::uniform_at used for the check vectors, one per vector from here on
+constexpr uint64_t STREAM_VERIFY = 16;
+
+struct VerifyResult {
+	double residual;	// ||A(BR) - CR|| / ||CR||, over all the vectors
+	double tolerance;
+	bool passed;
+	double time;
+};
+
+/**
+* rows × columns block times the matching rows of the column-major vectors, out[i * count + v] for row i and vector v.
+* Sums in double whatever T is, so rounding in the check stays well below rounding in the product.
+*/
+template <typename T> void multiply_vectors(const T* block, int rows, int columns, int stride, const double* vectors, int length, int first, int count, std::vector<double>& out) {
+	out.assign((size_t)rows * count, 0);
+	ThreadPool::instance().parallel_for(0, rows, [&](long long first_row, long long last_row) {
+		for (int i = (int)first_row; i < last_row; i++) {
+			const T* row = block + (size_t)i * stride;
+			for (int v = 0; v < count; v++) {
+				const double* x = vectors + (size_t)v * length + first;
+				double sum = 0;
+				for (int j = 0; j < columns; j++) {
+					sum += row[j] * x[j];
+				}
+				out[(size_t)i * count + v] = sum;
+			}
+		}
+	});
+}
+
+/**
+* Freivalds' check of C = A * B: for random vectors r, A(Br) has to match Cr, which costs O(N²) per vector
+* instead of the O(N³) of multiplying again. A wrong C passes with vanishing probability.
+* Runs on the blocks every rank already holds, whatever the distribution, and only moves vectors.
+* @param b_replicated Whether every rank holds all of B.
+*/
+template <typename T> VerifyResult verify_product(const Problem& problem, const ProcessGrid& grid, const Layout& layout, std::span<const T> a, std::span<const T> b, std::span<const T> c, bool b_replicated, int vectors) {
+	Timer timer;
+
+	// every rank can make any entry of the vectors, uniform in [-1, 1)
+	std::vector<double> r((size_t)vectors * problem.n);
+	for (int v = 0; v < vectors; v++) {
+		for (int j = 0; j < problem.n; j++) {
+			r[(size_t)v * problem.n + j] = 2 * RandomTools::uniform_at<double>(problem.seed, STREAM_VERIFY + v, j) - 1;
+		}
+	}
+
+	// Br for my rows of B, shared so everyone has all of it, unless everyone has all of B already
+	std::vector<double> partial;
+	multiply_vectors(b.data(), layout.b.rows.count, layout.b.columns.count, layout.b.columns.count, r.data(), problem.n, layout.b.columns.start, vectors, partial);
+
+	std::vector<double> br((size_t)vectors * problem.k, 0);
+	for (int i = 0; i < layout.b.rows.count; i++) {
+		for (int v = 0; v < vectors; v++) {
+			br[(size_t)v * problem.k + layout.b.rows.start + i] = partial[(size_t)i * vectors + v];
+		}
+	}
+	if (!b_replicated) {
+		MPI_Allreduce(MPI_IN_PLACE, br.data(), (int)br.size(), MPI_DOUBLE, MPI_SUM, grid.grid);
+	}
+
+	// A(Br) - Cr for my rows of C, summed over my grid row. A may hold more rows than C does.
+	int rows = layout.c.rows.count;
+	const T* a_rows = a.data() + (size_t)(layout.c.rows.start - layout.a.rows.start) * layout.a.columns.count;
+	std::vector<double> abr;
+	std::vector<double> cr;
+	multiply_vectors(a_rows, rows, layout.a.columns.count, layout.a.columns.count, br.data(), problem.k, layout.a.columns.start, vectors, abr);
+	multiply_vectors(c.data(), rows, layout.c.columns.count, layout.c.columns.count, r.data(), problem.n, layout.c.columns.start, vectors, cr);
+
+	std::vector<double> difference(abr.size());
+	for (size_t i = 0; i < abr.size(); i++) {
+		difference[i] = abr[i] - cr[i];
+	}
+	MPI_Allreduce(MPI_IN_PLACE, difference.data(), (int)difference.size(), MPI_DOUBLE, MPI_SUM, grid.row_comm);
+	MPI_Allreduce(MPI_IN_PLACE, cr.data(), (int)cr.size(), MPI_DOUBLE, MPI_SUM, grid.row_comm);
+
+	// one rank per grid row adds its rows to the norms
+	double norms[2] = { 0, 0 };
+	if (grid.coords[1] == 0) {
+		for (size_t i = 0; i < difference.size(); i++) {
+			norms[0] += difference[i] * difference[i];
+			norms[1] += cr[i] * cr[i];
+		}
+	}
+	MPI_Allreduce(MPI_IN_PLACE, norms, 2, MPI_DOUBLE, MPI_SUM, grid.grid);
+
+	VerifyResult result;
+	result.residual = (norms[1] > 0) ? std::sqrt(norms[0] / norms[1]) : std::sqrt(norms[0]);
+	// rounding in a length k dot product grows about like sqrt(k) ulps, allow a generous multiple of that
+	result.tolerance = 16 * std::sqrt((double)problem.k) * std::numeric_limits<T>::epsilon();
+	result.passed = result.residual <= result.tolerance;
+	result.time = timer.stop().count();
+	return result;
+}
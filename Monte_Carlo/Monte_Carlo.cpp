@@ -1,11 +1,403 @@
 #include "../programs.h"
+#include "integrands.h"
+#include "philox.h"
+#include "quasi_random.h"
 
 #include <mpi.h>
 #include <iostream>
 #include <string>
 #include <random>
+#include <algorithm>
+#include <bit>
+#include <climits>
 #include <cmath>
 #include <numbers>
+#include <vector>
+
+using std::vector;
+
+// Samples are drawn in fixed chunks, numbered from the start of the stream. Which rank draws a chunk
+// doesn't change what is in it, so the estimate for a seed is the same however many ranks there are.
+constexpr int CHUNK_BITS = 20;
+constexpr long long CHUNK_SAMPLES = 1LL << CHUNK_BITS;
+
+// Ranks take this many chunks per thread between combining their counts.
+constexpr int CHUNKS_PER_THREAD = 4;
+
+constexpr long long DEFAULT_SAMPLES = (long long)1e8;
+constexpr int DEFAULT_DIMENSION = 8;
+constexpr int DEFAULT_REPLICATES = 8; // independently scrambled copies of a quasi-random sequence
+constexpr double CONFIDENCE_Z = 1.959964; // 95% two-sided
+
+// Philox streams the points are drawn from, the seed is the key. Coordinates 2g and 2g + 1 come from stream STREAM_POINTS + g.
+constexpr uint64_t STREAM_POINTS = 0;
+// where the scrambles of the quasi-random sequences come from
+constexpr uint64_t STREAM_SCRAMBLE = 1ull << 32;
+
+enum class Sequence {
+	Philox,
+	Sobol,
+	Halton
+};
+
+/**
+* @return false if there is no sequence called name.
+*/
+inline bool sequence_from_name(const std::string& name, Sequence& sequence) {
+	if (name == "philox") sequence = Sequence::Philox;
+	else if (name == "sobol") sequence = Sequence::Sobol;
+	else if (name == "halton") sequence = Sequence::Halton;
+	else return false;
+	return true;
+}
+
+enum class Schedule {
+	Static,
+	Dynamic
+};
+
+struct ScheduleStats {
+	long long chunks = 0;
+	int rounds = 0; // or requests to the shared counter
+	double compute_time = 0;
+	double wait_time = 0;
+};
+
+struct SamplingOptions {
+	Sequence sequence = Sequence::Philox;
+	int dimension = 2;
+	int replicates = 1; // independently scrambled or stratified copies, the error comes from their spread
+	bool antithetic = false;
+	bool stratified = false;
+};
+
+/**
+* Draws the points of a chunk and adds up the integrand over them. Safe to use from several threads at once.
+*
+* The sums are laid out as [samples, sum of squares, sum over replicate 0, ..., sum over replicate R - 1].
+* A chunk is split evenly between the replicates, replicate r taking the next points of the sequence scrambled with scramble r.
+* Stratified pseudo-random points are replicated too, each replicate's share of a chunk stratified on its own with points of its own.
+*/
+class Sampler {
+public:
+	Sampler(const Integrand& integrand, const SamplingOptions& options, uint64_t seed)
+		: m_integrand(integrand), m_options(options), m_seed(seed), m_sobol((options.sequence == Sequence::Sobol) ? options.dimension : 0) {
+		int dimension = options.dimension;
+
+		for (int r = 0; r < options.replicates; r++) {
+			if (options.sequence == Sequence::Sobol) {
+				for (int d = 0; d < dimension; d++) {
+					m_sobol_seeds.push_back((uint32_t)(RandomTools::uniform_at(seed, STREAM_SCRAMBLE + r, d) * 0x1.0p32));
+				}
+			}
+			if (options.sequence == Sequence::Halton) {
+				m_halton.emplace_back(dimension);
+				m_halton.back().scramble(RandomTools::mix(seed ^ RandomTools::mix(STREAM_SCRAMBLE + r)));
+			}
+		}
+
+		// a grid of cells over the first few coordinates that divides a replicate's share of a chunk evenly, every cell gets the same number of samples
+		if (options.stratified) {
+			int bits = CHUNK_BITS - std::countr_zero((unsigned)options.replicates);
+			m_strata_dimensions = std::min(dimension, bits);
+			m_strata_levels = 1 << (bits / m_strata_dimensions);
+			m_strata = 1;
+			for (int d = 0; d < m_strata_dimensions; d++) m_strata *= m_strata_levels;
+		}
+	}
+
+	int sums_size() const {
+		return 2 + m_options.replicates;
+	}
+
+	int replicates() const {
+		return m_options.replicates;
+	}
+
+	/**
+	* Adds the samples chunk * CHUNK_SAMPLES ... chunk * CHUNK_SAMPLES + samples - 1 to sums.
+	*/
+	void add_chunk(long long chunk, long long samples, double* sums) const {
+		int dimension = m_options.dimension;
+		int replicates = m_options.replicates;
+		long long per_replicate = samples / replicates;
+
+		vector<double> points((size_t)dimension * QuasiRandom::BLOCK, 0.0);
+		vector<double> mirrored(m_options.antithetic ? points.size() : 0);
+		double values[QuasiRandom::BLOCK];
+		double mirrored_values[QuasiRandom::BLOCK];
+
+		for (int r = 0; r < replicates; r++) {
+			// the quasi-random replicates are the same points scrambled differently, the pseudo-random ones take different points
+			long long first_index = (m_options.sequence == Sequence::Philox) ? chunk * CHUNK_SAMPLES + r * per_replicate : chunk * (CHUNK_SAMPLES / replicates);
+			// a few separate sums, so the additions don't all wait on each other
+			constexpr int LANES = 8;
+			double block_sum[LANES] = {};
+			double block_squares[LANES] = {};
+
+			for (long long done = 0; done < per_replicate; done += QuasiRandom::BLOCK) {
+				int count = (int)std::min<long long>(QuasiRandom::BLOCK, per_replicate - done);
+				generate_block(r, first_index + done, done, count, points.data());
+				m_integrand.evaluate(dimension, points.data(), values);
+
+				// antithetic pairs count as one sample, the average of f(u) and f(1 - u)
+				if (m_options.antithetic) {
+					for (size_t i = 0; i < points.size(); i++) mirrored[i] = 1.0 - points[i];
+					m_integrand.evaluate(dimension, mirrored.data(), mirrored_values);
+					for (int lane = 0; lane < QuasiRandom::BLOCK; lane++) values[lane] = 0.5 * (values[lane] + mirrored_values[lane]);
+				}
+
+				// lanes past the end are masked out, so the loop is the same for every block and vectorizes
+				for (int lane = 0; lane < QuasiRandom::BLOCK; lane++) {
+					double value = (lane < count) ? values[lane] : 0.0;
+					block_sum[lane % LANES] += value;
+					block_squares[lane % LANES] += value * value;
+				}
+			}
+
+			double sum = 0;
+			double squares = 0;
+			for (int lane = 0; lane < LANES; lane++) {
+				sum += block_sum[lane];
+				squares += block_squares[lane];
+			}
+			sums[0] += (double)per_replicate;
+			sums[1] += squares;
+			sums[2 + r] += sum;
+		}
+	}
+
+private:
+	/**
+	* Points index ... index + count - 1 of replicate r, the first one being sample within_chunk of its chunk.
+	*/
+	void generate_block(int r, long long index, long long within_chunk, int count, double* out) const {
+		constexpr int BLOCK = QuasiRandom::BLOCK;
+		int dimension = m_options.dimension;
+
+		switch (m_options.sequence) {
+		case Sequence::Sobol:
+			m_sobol.generate_block((uint32_t)index, count, m_sobol_seeds.data() + (size_t)r * dimension, out);
+			return;
+		case Sequence::Halton:
+			m_halton[r].generate_block((uint64_t)index, count, out);
+			return;
+		case Sequence::Philox:
+			break;
+		}
+
+		uint32_t words[4][Philox::BLOCK];
+		for (int group = 0; 2 * group < dimension; group++) {
+			Philox::generate_block(m_seed, STREAM_POINTS + group, (uint64_t)index, words);
+			double* even = out + (size_t)(2 * group) * BLOCK;
+			for (int lane = 0; lane < BLOCK; lane++) even[lane] = Philox::to_unit(words[0][lane], words[1][lane]);
+			if (2 * group + 1 < dimension) {
+				double* odd = even + BLOCK;
+				for (int lane = 0; lane < BLOCK; lane++) odd[lane] = Philox::to_unit(words[2][lane], words[3][lane]);
+			}
+		}
+
+		// sample i of a chunk goes into cell i mod strata, and is moved into it
+		if (m_options.stratified) {
+			double width = 1.0 / m_strata_levels;
+			for (int lane = 0; lane < BLOCK; lane++) {
+				long long cell = (within_chunk + lane) % m_strata;
+				for (int d = 0; d < m_strata_dimensions; d++) {
+					double& x = out[(size_t)d * BLOCK + lane];
+					x = (cell % m_strata_levels + x) * width;
+					cell /= m_strata_levels;
+				}
+			}
+		}
+	}
+
+	const Integrand& m_integrand;
+	SamplingOptions m_options;
+	uint64_t m_seed;
+
+	QuasiRandom::Sobol m_sobol;
+	vector<uint32_t> m_sobol_seeds; // [replicate][dimension]
+	vector<QuasiRandom::Halton> m_halton; // one per replicate
+
+	int m_strata_dimensions = 0;
+	int m_strata_levels = 1;
+	long long m_strata = 1;
+};
+
+/**
+* The estimate and its standard error from the summed up chunks. With one replicate the samples are independent,
+* and the error comes from their variance. Quasi-random and stratified points aren't, so it comes from the spread of the replicates instead.
+*/
+void estimate(const vector<double>& sums, int replicates, double& value, double& error) {
+	double samples = sums[0];
+	if (samples == 0) {
+		value = 0;
+		error = INFINITY;
+		return;
+	}
+
+	double total = 0;
+	for (int r = 0; r < replicates; r++) total += sums[2 + r];
+	value = total / samples;
+
+	if (replicates == 1) {
+		double variance = std::max(0.0, sums[1] / samples - value * value);
+		error = std::sqrt(variance / samples);
+		return;
+	}
+
+	double per_replicate = samples / replicates;
+	double spread = 0;
+	for (int r = 0; r < replicates; r++) {
+		double mean = sums[2 + r] / per_replicate;
+		spread += (mean - value) * (mean - value);
+	}
+	error = std::sqrt(spread / ((double)replicates * (replicates - 1)));
+}
+
+/**
+* Adds up chunks first_chunk ... first_chunk + chunks - 1, one per task of the thread pool.
+* They are added to sums in chunk order, so the threads don't change the result.
+*/
+void add_chunks(const Sampler& sampler, long long first_chunk, int chunks, long long max_samples, vector<double>& per_chunk, vector<double>& sums) {
+	int sums_size = sampler.sums_size();
+	per_chunk.assign((size_t)chunks * sums_size, 0.0);
+	ThreadPool::instance().run(chunks, [&](int task) {
+		long long first = (first_chunk + task) * CHUNK_SAMPLES;
+		long long samples = std::min(CHUNK_SAMPLES, max_samples - first);
+		sampler.add_chunk(first_chunk + task, samples, per_chunk.data() + (size_t)task * sums_size);
+	});
+	for (int i = 0; i < chunks; i++) {
+		for (int s = 0; s < sums_size; s++) sums[s] += per_chunk[(size_t)i * sums_size + s];
+	}
+}
+
+/**
+* Every round, each rank takes the next few chunks in turn, as many as its threads can share.
+* The sums are combined between rounds, in the background while the next round is drawn.
+*/
+void sample_static(const Sampler& sampler, long long max_samples, double tolerance, vector<double>& local, ScheduleStats& stats) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	int sums_size = sampler.sums_size();
+	long long total_chunks = (max_samples + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+
+	long long round_chunks = (long long)CHUNKS_PER_THREAD * ThreadPool::instance().size();
+	long long chunks_before_me = 0;
+	long long chunks_per_round;
+	MPI_Exscan(&round_chunks, &chunks_before_me, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(&round_chunks, &chunks_per_round, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	if (rank == 0) chunks_before_me = 0;
+
+	// a copy of the local sums being summed over all ranks in the background
+	vector<double> sending(sums_size);
+	vector<double> global(sums_size, 0.0);
+	MPI_Request request = MPI_REQUEST_NULL;
+	vector<double> per_chunk;
+
+	for (long long round = 0;; round++) {
+		long long first_chunk = round * chunks_per_round + chunks_before_me;
+		int chunks = (int)std::clamp(total_chunks - first_chunk, 0LL, round_chunks);
+
+		Timer compute_timer;
+		add_chunks(sampler, first_chunk, chunks, max_samples, per_chunk, local);
+		stats.compute_time += compute_timer.stop().count();
+		stats.chunks += chunks;
+
+		// the sum started last round has had a whole round to finish, every rank sees the same one and stops together
+		if (request != MPI_REQUEST_NULL) {
+			Timer wait_timer;
+			MPI_Wait(&request, MPI_STATUS_IGNORE);
+			stats.wait_time += wait_timer.stop().count();
+			stats.rounds++;
+			double value;
+			double error;
+			estimate(global, sampler.replicates(), value, error);
+			bool precise_enough = tolerance > 0 && error <= tolerance;
+			if (precise_enough || global[0] >= max_samples) break;
+		}
+
+		sending = local;
+		MPI_Iallreduce(sending.data(), global.data(), sums_size, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD, &request);
+	}
+}
+
+/**
+* Ranks take chunks from a shared counter on rank 0 whenever they are free, so faster ranks end up drawing more of them.
+* With a tolerance, every rank also adds what it drew to shared sums on rank 0, and the first one to see them
+* precise enough moves the counter past the end, which stops the others after the chunks they already have.
+*/
+void sample_dynamic(const Sampler& sampler, long long max_samples, double tolerance, vector<double>& local, ScheduleStats& stats) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	int sums_size = sampler.sums_size();
+	long long total_chunks = (max_samples + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+	// one chunk for each thread per request
+	long long request_chunks = ThreadPool::instance().size();
+
+	long long* next_chunk;
+	MPI_Win counter_window;
+	MPI_Win_allocate((rank == 0) ? sizeof(long long) : 0, sizeof(long long), MPI_INFO_NULL, MPI_COMM_WORLD, &next_chunk, &counter_window);
+	double* shared_sums;
+	MPI_Win sums_window;
+	MPI_Win_allocate((rank == 0) ? sums_size * sizeof(double) : 0, sizeof(double), MPI_INFO_NULL, MPI_COMM_WORLD, &shared_sums, &sums_window);
+	MPI_Win_lock_all(0, counter_window);
+	MPI_Win_lock_all(0, sums_window);
+	if (rank == 0) {
+		*next_chunk = 0;
+		std::fill(shared_sums, shared_sums + sums_size, 0.0);
+		MPI_Win_sync(counter_window);
+		MPI_Win_sync(sums_window);
+	}
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	vector<double> per_chunk;
+	vector<double> drawn(sums_size);
+	vector<double> before(sums_size);
+
+	while (true) {
+		Timer wait_timer;
+		long long first_chunk;
+		MPI_Fetch_and_op(&request_chunks, &first_chunk, MPI_LONG_LONG, 0, 0, MPI_SUM, counter_window);
+		MPI_Win_flush(0, counter_window);
+		stats.wait_time += wait_timer.stop().count();
+
+		if (first_chunk >= total_chunks) break;
+		int chunks = (int)std::min(request_chunks, total_chunks - first_chunk);
+
+		Timer compute_timer;
+		std::fill(drawn.begin(), drawn.end(), 0.0);
+		add_chunks(sampler, first_chunk, chunks, max_samples, per_chunk, drawn);
+		for (int s = 0; s < sums_size; s++) local[s] += drawn[s];
+		stats.compute_time += compute_timer.stop().count();
+		stats.chunks += chunks;
+		stats.rounds++;
+
+		if (tolerance > 0) {
+			Timer share_timer;
+			MPI_Get_accumulate(drawn.data(), sums_size, MPI_DOUBLE, before.data(), sums_size, MPI_DOUBLE, 0, 0, sums_size, MPI_DOUBLE, MPI_SUM, sums_window);
+			MPI_Win_flush(0, sums_window);
+			for (int s = 0; s < sums_size; s++) before[s] += drawn[s];
+
+			double value;
+			double error;
+			estimate(before, sampler.replicates(), value, error);
+			if (error <= tolerance) {
+				long long ignored;
+				MPI_Fetch_and_op(&total_chunks, &ignored, MPI_LONG_LONG, 0, 0, MPI_REPLACE, counter_window);
+				MPI_Win_flush(0, counter_window);
+			}
+			stats.wait_time += share_timer.stop().count();
+		}
+	}
+
+	MPI_Win_unlock_all(sums_window);
+	MPI_Win_unlock_all(counter_window);
+	MPI_Win_free(&sums_window);
+	MPI_Win_free(&counter_window);
+}
 
 int monte_carlo(Arguments args) {
 	int rank;
@@ -13,44 +405,118 @@ int monte_carlo(Arguments args) {
 	int world_size;
 	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
 
-	int total_no_of_iterations = (args.has(0)) ? atoi(args.get(0)) : (int)1e8;
-	int iterations_per_thread = total_no_of_iterations / world_size;
+	std::string integrand_name = args.option("integrand", "pi");
+	if (INTEGRANDS.count(integrand_name) == 0) {
+		if (rank == 0) {
+			std::cerr << "Error: unknown integrand " << integrand_name << ". Known ones are:\n";
+			for (const auto& [name, integrand] : INTEGRANDS) std::cerr << "  " << name << ": " << integrand.description << "\n";
+		}
+		return 1;
+	}
+	const Integrand& integrand = INTEGRANDS.at(integrand_name);
+
+	SamplingOptions sampling;
+	std::string sequence_name = args.option("sequence", "philox");
+	if (!sequence_from_name(sequence_name, sampling.sequence)) {
+		if (rank == 0) std::cerr << "Error: unknown sequence " << sequence_name << ", it has to be philox, sobol or halton.\n";
+		return 1;
+	}
+	sampling.dimension = (integrand.dimension > 0) ? integrand.dimension : (int)args.option_int("dimension", DEFAULT_DIMENSION);
+	sampling.antithetic = args.has_option("antithetic");
+	sampling.stratified = args.has_option("stratify") && sampling.sequence == Sequence::Philox;
+	// the variance of independent samples says nothing about how much stratifying took off, so stratified runs are replicated too
+	bool replicated = sampling.sequence != Sequence::Philox || sampling.stratified;
+	sampling.replicates = replicated ? (int)std::bit_floor((unsigned)std::clamp<long long>(args.option_int("replicates", DEFAULT_REPLICATES), 2, 64)) : 1;
 
-	if (rank == world_size - 1) {
-		iterations_per_thread += total_no_of_iterations % world_size;
+	if (sampling.sequence == Sequence::Sobol && sampling.dimension > QuasiRandom::Sobol::MAX_DIMENSION) {
+		if (rank == 0) std::cerr << "Error: the Sobol sequence goes up to " << QuasiRandom::Sobol::MAX_DIMENSION << " dimensions.\n";
+		return 1;
+	}
+
+	// parsed as a double first, so 1e10 works too
+	long long max_samples = (args.has(0)) ? (long long)std::stod(args.get(0)) : DEFAULT_SAMPLES;
+	double tolerance = args.option_double("tolerance", 0);
+	if (tolerance > 0 && !args.has(0)) max_samples = LLONG_MAX / 2;
+	if (sampling.sequence == Sequence::Sobol) max_samples = std::min(max_samples, (1LL << 32) * sampling.replicates);
+
+	// stratified and quasi-random sampling only balance out over whole chunks
+	if (sampling.sequence != Sequence::Philox || sampling.stratified) {
+		max_samples = (max_samples + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES * CHUNK_SAMPLES;
 	}
 
 	std::random_device rd;
-	std::mt19937 rng(rd() ^ rank * RANDOM_SEED_MULTIPLIER);
-	std::uniform_real_distribution<double> dist(0.0, 1.0);
+	unsigned long long seed = args.has_option("seed") ? std::stoull(args.option("seed")) : rd();
+	MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+
+	Sampler sampler(integrand, sampling, seed);
 
-	double inside_circle = 0;
-	double factor = 4 / (double)total_no_of_iterations;
+	std::string schedule_name = args.option("schedule", "static");
+	if (schedule_name != "static" && schedule_name != "dynamic") {
+		if (rank == 0) std::cerr << "Error: unknown schedule " << schedule_name << ", it has to be static or dynamic.\n";
+		return 1;
+	}
+	Schedule schedule = (schedule_name == "dynamic") ? Schedule::Dynamic : Schedule::Static;
+	vector<double> local(sampler.sums_size(), 0.0);
+	ScheduleStats stats;
 
 	Timer timer;
-	while (iterations_per_thread--) {
-		double x = dist(rng);
-		double y = dist(rng);
-		double distance = x * x + y * y;
-		if (distance <= 1) {
-			inside_circle++;
-		}
+	if (schedule == Schedule::Dynamic) {
+		sample_dynamic(sampler, max_samples, tolerance, local, stats);
+	}
+	else {
+		sample_static(sampler, max_samples, tolerance, local, stats);
 	}
 	timer.stop();
 
-	double total_inside_circle;
-	MPI_Reduce(&inside_circle, &total_inside_circle, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+	vector<double> global(sampler.sums_size(), 0.0);
+	// the last round isn't in the sum that stopped the run, so everything is added up once more
+	MPI_Reduce(local.data(), global.data(), sampler.sums_size(), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
 
 	double local_time_taken = timer.duration().count();
 	double max_time_taken;
 	MPI_Reduce(&local_time_taken, &max_time_taken, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
+	// how the work was shared out
+	constexpr int STATS = 3;
+	double per_rank[STATS] = { (double)stats.chunks, stats.compute_time, stats.wait_time };
+	vector<double> all_ranks((rank == 0) ? STATS * world_size : 0);
+	MPI_Gather(per_rank, STATS, MPI_DOUBLE, all_ranks.data(), STATS, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
 	if (rank == 0) {
-		double pi = total_inside_circle * factor;
-		std::cout << "PI: " << pi << std::endl;
-		std::cout << "Accuracy: " << 100 - (std::abs(std::numbers::pi - pi) / std::numbers::pi) * 100 << "%" << std::endl;
+		long long samples = (long long)global[0];
+		double value;
+		double error;
+		estimate(global, sampler.replicates(), value, error);
+		double exact = integrand.exact(sampling.dimension);
+		const char* sequence_names[] = { "philox", "sobol", "halton" };
+
+		std::cout << "Seed: " << seed << std::endl;
+		if (integrand_name != "pi") {
+			std::cout << "Integrand: " << integrand_name << " (" << integrand.description << ") in " << sampling.dimension << " dimensions." << std::endl;
+		}
+		std::cout << "Sequence: " << sequence_names[(int)sampling.sequence];
+		if (sampling.stratified) std::cout << ", stratified, " << sampling.replicates << " independent replicates";
+		else if (sampling.replicates > 1) std::cout << ", " << sampling.replicates << " scrambled replicates";
+		if (sampling.antithetic) std::cout << ", antithetic";
+		std::cout << "." << std::endl;
+		if (schedule == Schedule::Dynamic) {
+			std::cout << "Samples: " << samples << ", handed out through a shared counter." << std::endl;
+		}
+		else {
+			std::cout << "Samples: " << samples << ", combined over " << stats.rounds << " rounds." << std::endl;
+		}
+		std::cout << ((integrand_name == "pi") ? "PI: " : "Integral: ") << std::setprecision(12) << value << " +- " << std::setprecision(3) << error << " (standard error)" << std::endl;
+		std::cout << "95% confidence interval: [" << std::setprecision(12) << value - CONFIDENCE_Z * error << ", " << value + CONFIDENCE_Z * error << "]" << std::setprecision(6) << std::endl;
+		std::cout << "Exact: " << std::setprecision(12) << exact << ", off by " << std::setprecision(3) << std::abs(value - exact) << std::setprecision(6) << std::endl;
+		std::cout << "Accuracy: " << 100 - (std::abs(exact - value) / std::abs(exact)) * 100 << "%" << std::endl;
+		for (int i = 0; i < world_size; i++) {
+			const double* stat = all_ranks.data() + STATS * i;
+			std::cout << "Rank " << i << " drew " << stat[0] << " chunks. Computing took " << stat[1] << " seconds, "
+				<< ((schedule == Schedule::Dynamic) ? "waiting for work " : "waiting for the others ") << stat[2] << "." << std::endl;
+		}
 		std::cout << "Slowest thread took " << max_time_taken << " seconds to compute." << std::endl;
+		std::cout << "Drew " << samples / max_time_taken / 1e6 << " million samples/s." << std::endl;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <map>
+#include <numbers>
+#include <string>
+
+#include "quasi_random.h"
+
+/**
+* Functions over the unit cube [0, 1)^dimension that monte_carlo can integrate.
+* They are evaluated a block of points at a time, points[d * QuasiRandom::BLOCK + lane] is coordinate d of a point,
+* with the loop over the lanes innermost so it can be vectorized.
+*/
+struct Integrand {
+	// 0 if the integrand works in any dimension
+	int dimension;
+	void (*evaluate)(int dimension, const double* points, double* values);
+	// the exact value of the integral, to compare against
+	double (*exact)(int dimension);
+	const char* description;
+};
+
+namespace Integrands {
+	constexpr int BLOCK = QuasiRandom::BLOCK;
+
+	// the coefficients of the oscillatory integrand, coordinate d gets OSCILLATORY_SCALE / (d + 1)
+	constexpr double OSCILLATORY_SCALE = 2.0;
+	constexpr double OSCILLATORY_SHIFT = 0.5;
+
+	inline void quarter_circle(int, const double* points, double* values) {
+		const double* x = points;
+		const double* y = points + BLOCK;
+		for (int lane = 0; lane < BLOCK; lane++) {
+			values[lane] = (x[lane] * x[lane] + y[lane] * y[lane] <= 1.0) ? 4.0 : 0.0;
+		}
+	}
+
+	/**
+	* The indicator of the unit ball, scaled from the cube [-1, 1)^dimension.
+	*/
+	inline void ball(int dimension, const double* points, double* values) {
+		double norm[BLOCK] = {};
+		for (int d = 0; d < dimension; d++) {
+			const double* x = points + d * BLOCK;
+			for (int lane = 0; lane < BLOCK; lane++) {
+				double centred = 2 * x[lane] - 1;
+				norm[lane] += centred * centred;
+			}
+		}
+		double volume = std::ldexp(1.0, dimension);
+		for (int lane = 0; lane < BLOCK; lane++) values[lane] = (norm[lane] <= 1.0) ? volume : 0.0;
+	}
+
+	inline double ball_volume(int dimension) {
+		return std::pow(std::numbers::pi, dimension / 2.0) / std::tgamma(dimension / 2.0 + 1);
+	}
+
+	/**
+	* exp(-|x|^2), smooth and separable.
+	*/
+	inline void gaussian(int dimension, const double* points, double* values) {
+		double norm[BLOCK] = {};
+		for (int d = 0; d < dimension; d++) {
+			const double* x = points + d * BLOCK;
+			for (int lane = 0; lane < BLOCK; lane++) norm[lane] += x[lane] * x[lane];
+		}
+		for (int lane = 0; lane < BLOCK; lane++) values[lane] = std::exp(-norm[lane]);
+	}
+
+	inline double gaussian_exact(int dimension) {
+		return std::pow(std::sqrt(std::numbers::pi) / 2 * std::erf(1.0), dimension);
+	}
+
+	/**
+	* Genz's oscillatory test function, cos(2 pi shift + sum a_d x_d).
+	*/
+	inline void oscillatory(int dimension, const double* points, double* values) {
+		double phase[BLOCK];
+		for (int lane = 0; lane < BLOCK; lane++) phase[lane] = 2 * std::numbers::pi * OSCILLATORY_SHIFT;
+		for (int d = 0; d < dimension; d++) {
+			const double* x = points + d * BLOCK;
+			double a = OSCILLATORY_SCALE / (d + 1);
+			for (int lane = 0; lane < BLOCK; lane++) phase[lane] += a * x[lane];
+		}
+		for (int lane = 0; lane < BLOCK; lane++) values[lane] = std::cos(phase[lane]);
+	}
+
+	inline double oscillatory_exact(int dimension) {
+		// the real part of exp(i 2 pi shift) * prod (exp(i a_d) - 1) / (i a_d)
+		std::complex<double> value = std::polar(1.0, 2 * std::numbers::pi * OSCILLATORY_SHIFT);
+		for (int d = 0; d < dimension; d++) {
+			double a = OSCILLATORY_SCALE / (d + 1);
+			value *= (std::polar(1.0, a) - 1.0) / std::complex<double>(0, a);
+		}
+		return value.real();
+	}
+}
+
+const std::map<std::string, Integrand> INTEGRANDS = {
+	std::make_pair("pi", Integrand{ 2, Integrands::quarter_circle, [](int) { return std::numbers::pi; }, "4 inside the quarter circle, 0 outside" }),
+	std::make_pair("ball", Integrand{ 0, Integrands::ball, Integrands::ball_volume, "volume of the unit ball" }),
+	std::make_pair("gaussian", Integrand{ 0, Integrands::gaussian, Integrands::gaussian_exact, "exp(-|x|^2)" }),
+	std::make_pair("oscillatory", Integrand{ 0, Integrands::oscillatory, Integrands::oscillatory_exact, "Genz oscillatory, cos(pi + sum 2x_d / (d + 1))" }),
+};
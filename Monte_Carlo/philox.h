@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+* Philox4x32-10, the counter-based generator from Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3".
+* Every output is a pure function of a 128 bit counter and a 64 bit key, so any part of the stream can be
+* generated directly, by any rank, in any order, without generating what comes before it.
+*/
+namespace Philox {
+	constexpr uint32_t MULTIPLIER_0 = 0xD2511F53;
+	constexpr uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+	constexpr uint32_t WEYL_0 = 0x9E3779B9;
+	constexpr uint32_t WEYL_1 = 0xBB67AE85;
+	constexpr int ROUNDS = 10;
+
+	// counters generated together. The lanes don't depend on each other, so the compiler can keep them in vector registers.
+	constexpr int BLOCK = 64;
+
+	/**
+	* Generates the outputs for the counters (first + lane, stream) for lane = 0 ... BLOCK - 1.
+	* out[w][lane] is word w of the output for that lane.
+	*/
+	inline void generate_block(uint64_t key, uint64_t stream, uint64_t first, uint32_t out[4][BLOCK]) {
+		uint32_t* x0 = out[0];
+		uint32_t* x1 = out[1];
+		uint32_t* x2 = out[2];
+		uint32_t* x3 = out[3];
+
+		for (int lane = 0; lane < BLOCK; lane++) {
+			uint64_t counter = first + lane;
+			x0[lane] = (uint32_t)counter;
+			x1[lane] = (uint32_t)(counter >> 32);
+			x2[lane] = (uint32_t)stream;
+			x3[lane] = (uint32_t)(stream >> 32);
+		}
+
+		uint32_t key_0 = (uint32_t)key;
+		uint32_t key_1 = (uint32_t)(key >> 32);
+		for (int round = 0; round < ROUNDS; round++) {
+			for (int lane = 0; lane < BLOCK; lane++) {
+				uint64_t product_0 = (uint64_t)MULTIPLIER_0 * x0[lane];
+				uint64_t product_1 = (uint64_t)MULTIPLIER_1 * x2[lane];
+				uint32_t y0 = (uint32_t)(product_1 >> 32) ^ x1[lane] ^ key_0;
+				uint32_t y2 = (uint32_t)(product_0 >> 32) ^ x3[lane] ^ key_1;
+				x1[lane] = (uint32_t)product_1;
+				x3[lane] = (uint32_t)product_0;
+				x0[lane] = y0;
+				x2[lane] = y2;
+			}
+			key_0 += WEYL_0;
+			key_1 += WEYL_1;
+		}
+	}
+
+	/**
+	* @return A double in [0, 1) made from the top 53 of the 64 bits in two output words.
+	*/
+	inline double to_unit(uint32_t high, uint32_t low) {
+		return (double)((((uint64_t)high << 32) | low) >> 11) * 0x1.0p-53;
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../helpers.h"
+#include "philox.h"
+#include "sobol_table.h"
+
+/**
+* Low-discrepancy sequences. Point i of either one can be computed directly from i, so a rank can skip
+* ahead to the start of its chunk instead of generating the points before it.
+* Both are randomized (scrambled) by a seed, which keeps their spread but makes every scramble an unbiased estimate,
+* so the error can be estimated from a few independently scrambled copies.
+*/
+namespace QuasiRandom {
+	// points generated together, stored a dimension at a time: out[d * BLOCK + lane]
+	constexpr int BLOCK = Philox::BLOCK;
+
+	inline uint32_t reverse_bits(uint32_t x) {
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+		x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+
+	/**
+	* Owen's nested uniform scramble of a 32 bit fraction, with the hash from Burley,
+	* "Practical Hash-based Owen Scrambling": each bit is flipped depending only on the bits above it.
+	*/
+	inline uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+		x = reverse_bits(x);
+		x += seed;
+		x ^= x * 0x6c50b47cu;
+		x ^= x * 0xb82f1e52u;
+		x ^= x * 0xc7afe638u;
+		x ^= x * 0x8d22f6e6u;
+		return reverse_bits(x);
+	}
+
+	class Sobol {
+	public:
+		static constexpr int MAX_DIMENSION = SobolTable::MAX_DIMENSION;
+		static constexpr int BITS = 32;
+
+		Sobol(int dimension) : m_dimension(dimension), m_directions((size_t)dimension * BITS) {
+			for (int d = 0; d < dimension; d++) {
+				uint32_t* v = m_directions.data() + (size_t)d * BITS;
+				if (d == 0) {
+					for (int bit = 0; bit < BITS; bit++) v[bit] = 1u << (BITS - 1 - bit);
+					continue;
+				}
+
+				const SobolTable::Entry& entry = SobolTable::ENTRIES[d - 1];
+				int degree = std::bit_width((unsigned)entry.polynomial) - 1;
+
+				for (int k = 0; k < degree; k++) v[k] = (uint32_t)entry.initial[k] << (BITS - 1 - k);
+				for (int k = degree; k < BITS; k++) {
+					v[k] = v[k - degree] ^ (v[k - degree] >> degree);
+					for (int l = 1; l < degree; l++) {
+						if ((entry.polynomial >> (degree - l)) & 1) v[k] ^= v[k - l];
+					}
+				}
+			}
+		}
+
+		/**
+		* Points first ... first + count - 1 (count <= BLOCK) in Gray code order, each coordinate Owen scrambled
+		* with a seed of its own. The first point is built from its index, the rest by flipping one direction number each.
+		*/
+		void generate_block(uint32_t first, int count, const uint32_t* seeds, double* out) const {
+			for (int d = 0; d < m_dimension; d++) {
+				const uint32_t* v = m_directions.data() + (size_t)d * BITS;
+				uint32_t gray = first ^ (first >> 1);
+				uint32_t x = 0;
+				for (int bit = 0; gray; bit++, gray >>= 1) {
+					if (gray & 1) x ^= v[bit];
+				}
+
+				double* row = out + (size_t)d * BLOCK;
+				for (int lane = 0; lane < count; lane++) {
+					// flipped on the way into a point rather than out of it, so the last of the 2^32 points doesn't look past the direction numbers
+					if (lane > 0) x ^= v[std::countr_zero(first + lane)];
+					row[lane] = owen_scramble(x, seeds[d]) * 0x1.0p-32;
+				}
+			}
+		}
+
+	private:
+		int m_dimension;
+		// BITS direction numbers per dimension
+		std::vector<uint32_t> m_directions;
+	};
+
+	class Halton {
+	public:
+		static constexpr int MAX_DIGITS = 53; // base 2
+		Halton(int dimension) : m_dimension(dimension) {
+			for (int candidate = 2; (int)m_bases.size() < dimension; candidate++) {
+				bool prime = true;
+				for (int base : m_bases) {
+					if (base * base > candidate) break;
+					if (candidate % base == 0) prime = false;
+				}
+				if (prime) m_bases.push_back(candidate);
+			}
+
+			// enough digits for a double
+			for (int base : m_bases) m_digits.push_back((int)std::ceil(53 / std::log2(base)));
+		}
+
+		/**
+		* Scrambles the sequence with a random permutation of the digits for every digit position of every dimension.
+		* The permutations leave the number of points in each elementary interval unchanged.
+		*/
+		void scramble(uint64_t seed) {
+			m_permutations.clear();
+			m_offsets.clear();
+			for (int d = 0; d < m_dimension; d++) {
+				int base = m_bases[d];
+				for (int digit = 0; digit < m_digits[d]; digit++) {
+					m_offsets.push_back((int)m_permutations.size());
+					size_t start = m_permutations.size();
+					for (int i = 0; i < base; i++) m_permutations.push_back(i);
+					// Fisher-Yates
+					for (int i = base - 1; i > 0; i--) {
+						uint64_t r = RandomTools::mix(seed ^ RandomTools::mix(((uint64_t)d << 40) | ((uint64_t)digit << 20) | (uint64_t)i));
+						std::swap(m_permutations[start + i], m_permutations[start + r % (i + 1)]);
+					}
+				}
+			}
+		}
+
+		/**
+		* Points first ... first + count - 1 (count <= BLOCK), as scrambled radical inverses of the index in each prime base.
+		* Only the first point is converted digit by digit, the rest are made by adding one to the digits of the one before,
+		* which changes less than two of them on average.
+		*/
+		void generate_block(uint64_t first, int count, double* out) const {
+			int offset = 0;
+			for (int d = 0; d < m_dimension; d++) {
+				int base = m_bases[d];
+				int digits = m_digits[d];
+				const int* offsets = m_offsets.data() + offset;
+				double* row = out + (size_t)d * BLOCK;
+
+				int digit_values[MAX_DIGITS];
+				double scales[MAX_DIGITS];
+				double value = 0;
+				double scale = 1.0 / base;
+				uint64_t index = first;
+				for (int k = 0; k < digits; k++) {
+					digit_values[k] = (int)(index % base);
+					index /= base;
+					scales[k] = scale;
+					value += m_permutations[offsets[k] + digit_values[k]] * scale;
+					scale /= base;
+				}
+
+				for (int lane = 0; lane < count; lane++) {
+					row[lane] = value;
+					for (int k = 0; k < digits; k++) {
+						int old_digit = digit_values[k];
+						int new_digit = (old_digit + 1 == base) ? 0 : old_digit + 1;
+						const int* permutation = m_permutations.data() + offsets[k];
+						value += (permutation[new_digit] - permutation[old_digit]) * scales[k];
+						digit_values[k] = new_digit;
+						if (new_digit != 0) break;
+					}
+				}
+				offset += digits;
+			}
+		}
+
+	private:
+		int m_dimension;
+		std::vector<int> m_bases;
+		std::vector<int> m_digits;
+		std::vector<int> m_permutations;
+		std::vector<int> m_offsets; // of the permutation for each (dimension, digit)
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../thread_pool.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+* A block of rows of a sparse matrix in compressed sparse row form.
+* The nonzeros of local row i are values[row_offsets[i] .. row_offsets[i + 1]), in the columns with the same indices in column_indices.
+*/
+struct CsrMatrix {
+	int rows = 0;
+	std::vector<size_t> row_offsets = { 0 };
+	std::vector<int> column_indices;
+	std::vector<double> values;
+
+	size_t nonzeros() const { return values.size(); }
+};
+
+namespace Csr {
+	/**
+	* y = A x, with one thread per share of the rows.
+	*/
+	inline void spmv(const CsrMatrix& a, const double* x, double* y) {
+		ThreadPool::instance().parallel_for(0, a.rows, [&](long long first, long long last) {
+			for (long long i = first; i < last; i++) {
+				double sum = 0;
+				for (size_t p = a.row_offsets[i]; p < a.row_offsets[i + 1]; p++) {
+					sum += a.values[p] * x[a.column_indices[p]];
+				}
+				y[i] = sum;
+			}
+		});
+	}
+
+	/**
+	* Y = A X for width vectors at once. X and Y are row-major, so the width values a nonzero
+	* is multiplied with are next to each other, and every nonzero is loaded once for all of them.
+	*/
+	inline void spmm(const CsrMatrix& a, const double* x, double* y, int width) {
+		ThreadPool::instance().parallel_for(0, a.rows, [&](long long first, long long last) {
+			for (long long i = first; i < last; i++) {
+				double* out = y + (size_t)i * width;
+				for (int v = 0; v < width; v++) out[v] = 0;
+
+				for (size_t p = a.row_offsets[i]; p < a.row_offsets[i + 1]; p++) {
+					double value = a.values[p];
+					const double* in = x + (size_t)a.column_indices[p] * width;
+					for (int v = 0; v < width; v++) {
+						out[v] += value * in[v];
+					}
+				}
+			}
+		});
+	}
+}
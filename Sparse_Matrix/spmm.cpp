@@ -0,0 +1,402 @@
+#include "../programs.h"
+#include "csr.h"
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::vector;
+
+// These are defaults, overridden if arguments are provided.
+constexpr int MATRIX_SIZE = 200000;
+constexpr int NONZEROS_PER_ROW = 32;
+constexpr int SPMM_WIDTH = 8;
+constexpr int ITERATIONS = 10;
+constexpr int BANDWIDTH = 2000;			// most nonzeros lie within this many columns of the diagonal
+constexpr double FAR_FRACTION = 0.02;	// the rest are anywhere in the row
+constexpr double SKEW = 2;				// how much longer the first rows are than the last ones, 0 for all the same
+
+// streams of RandomTools::uniform_at
+constexpr uint64_t STREAM_LENGTHS = 0;
+constexpr uint64_t STREAM_FAR = 1;
+constexpr uint64_t STREAM_COLUMNS = 2;
+constexpr uint64_t STREAM_VALUES = 3;
+constexpr uint64_t STREAM_X = 16; // one per vector from here on
+
+/**
+* A generated size × size sparse matrix. Every rank can work out any row of it on its own.
+*/
+struct SparseProblem {
+	int size;
+	int nonzeros_per_row;	// on average
+	int bandwidth;
+	double far_fraction;
+	double skew;
+	uint64_t seed;
+};
+
+/**
+* Everything a rank needs to fill in the entries of x its rows use but another rank owns.
+* Those entries are stored after the rank's own ones, grouped by the rank they come from.
+*/
+struct Halo {
+	vector<int> receive_ranks;
+	vector<int> receive_counts;
+	vector<int> send_ranks;
+	vector<int> send_counts;
+	vector<int> send_indices; // local indices of the entries to send, grouped the same way as send_ranks
+
+	int size() const {
+		int total = 0;
+		for (int count : receive_counts) total += count;
+		return total;
+	}
+};
+
+struct KernelStats {
+	double compute_time = 0;
+	double exchange_time = 0;
+	double checksum = 0;
+};
+
+int row_length(const SparseProblem& problem, int row);
+vector<int> partition_rows(const SparseProblem& problem, int parts, bool by_nonzeros);
+CsrMatrix generate_rows(const SparseProblem& problem, BlockRange rows);
+Halo build_halo(CsrMatrix& matrix, const vector<int>& boundaries, int rank);
+void exchange_halo(const Halo& halo, double* x, int owned_rows, int width, vector<double>& send_buffer);
+KernelStats run_kernel(const SparseProblem& problem, const CsrMatrix& matrix, const Halo& halo, BlockRange rows, int width, int iterations);
+
+int spmm(Arguments args) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	int world_size;
+	MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+	SparseProblem problem = { MATRIX_SIZE, NONZEROS_PER_ROW, BANDWIDTH, FAR_FRACTION, SKEW, 0 };
+	if (args.has(0)) problem.size = std::stoi(args.get(0));
+	if (args.has(1)) problem.nonzeros_per_row = std::stoi(args.get(1));
+	problem.bandwidth = (int)args.option_int("bandwidth", problem.bandwidth);
+	problem.far_fraction = args.option_double("far", problem.far_fraction);
+	problem.skew = args.option_double("skew", problem.skew);
+
+	int width = (int)args.option_int("vectors", SPMM_WIDTH);
+	int iterations = (int)args.option_int("iterations", ITERATIONS);
+	bool by_nonzeros = args.option("partition", "nonzeros") != "rows";
+
+	std::random_device rd;
+	unsigned long long seed = args.has_option("seed") ? std::stoull(args.option("seed")) : rd();
+	MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+	problem.seed = seed;
+
+	Timer setup_timer;
+	vector<int> boundaries = partition_rows(problem, world_size, by_nonzeros);
+	BlockRange rows = { boundaries[rank], boundaries[rank + 1] - boundaries[rank] };
+	CsrMatrix matrix = generate_rows(problem, rows);
+	Halo halo = build_halo(matrix, boundaries, rank);
+	double setup_time = setup_timer.stop().count();
+
+	// how even the split is, and how much of x every multiply has to move
+	long long nonzeros = (long long)matrix.nonzeros();
+	long long total_nonzeros;
+	long long most_nonzeros;
+	MPI_Reduce(&nonzeros, &total_nonzeros, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(&nonzeros, &most_nonzeros, 1, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	int halo_stats[2] = { halo.size(), (int)halo.receive_ranks.size() };
+	int total_halo[2];
+	int largest_halo[2];
+	MPI_Reduce(halo_stats, total_halo, 2, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+	MPI_Reduce(halo_stats, largest_halo, 2, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	double max_setup_time;
+	MPI_Reduce(&setup_time, &max_setup_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	if (rank == 0) {
+		std::cout << problem.size << "x" << problem.size << " matrix with " << total_nonzeros << " nonzeros ("
+			<< 100.0 * total_nonzeros / ((double)problem.size * problem.size) << "% dense), seed " << problem.seed << std::endl;
+		std::cout << "Rows split by " << (by_nonzeros ? "nonzeros" : "rows") << ": the busiest rank has "
+			<< most_nonzeros / ((double)total_nonzeros / world_size) << " times the average number of nonzeros." << std::endl;
+		std::cout << "Halo: " << (double)total_halo[0] / world_size << " remote entries of x from " << (double)total_halo[1] / world_size
+			<< " ranks on average, at most " << largest_halo[0] << " from " << largest_halo[1] << "." << std::endl;
+		std::cout << "Slowest rank took " << max_setup_time << " seconds to generate and partition its rows." << std::endl;
+		std::cout << std::endl;
+	}
+
+	for (int kernel_width : { 1, width }) {
+		KernelStats stats = run_kernel(problem, matrix, halo, rows, kernel_width, iterations);
+
+		double time = stats.compute_time + stats.exchange_time;
+		double max_time;
+		double max_exchange_time;
+		double checksum;
+		MPI_Reduce(&time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+		MPI_Reduce(&stats.exchange_time, &max_exchange_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+		MPI_Reduce(&stats.checksum, &checksum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+		if (rank == 0) {
+			double per_multiply = max_time / iterations;
+			if (kernel_width == 1) {
+				std::cout << "SpMV:" << std::endl;
+			}
+			else {
+				std::cout << "SpMM with " << kernel_width << " vectors:" << std::endl;
+			}
+			std::cout << "Output checksum: " << std::setprecision(12) << checksum << std::setprecision(6) << std::endl;
+			std::cout << "Slowest rank took " << per_multiply << " seconds per multiply, " << max_exchange_time / iterations << " of them exchanging halos." << std::endl;
+			std::cout << "Achieved " << total_nonzeros / per_multiply / 1e6 << " million nonzeros/s, "
+				<< 2.0 * total_nonzeros * kernel_width / per_multiply / 1e9 << " GFLOP/s." << std::endl;
+			std::cout << std::endl;
+		}
+
+		if (width == 1) break;
+	}
+
+	return 0;
+}
+
+/**
+* Row lengths fall off from the first row to the last, so splitting by row count alone leaves the first ranks with most of the work.
+* @return The number of nonzeros row asks for, before duplicate columns are merged.
+*/
+int row_length(const SparseProblem& problem, int row) {
+	double position = (row + 0.5) / problem.size;
+	double weight = (problem.skew + 1) * std::pow(1 - position, problem.skew);
+	double jitter = 0.5 + RandomTools::uniform_at(problem.seed, STREAM_LENGTHS, row);
+	int length = (int)std::lround(problem.nonzeros_per_row * weight * jitter);
+	return std::clamp(length, 1, problem.size);
+}
+
+/**
+* Splits the rows into contiguous parts with about the same number of nonzeros each, or the same number of rows.
+* Every rank measures an equal share of the rows, and the boundaries are found where the running total
+* crosses each multiple of total / parts, so no rank ever looks at all of them.
+* @return parts + 1 boundaries, part i being rows [boundaries[i], boundaries[i + 1]).
+*/
+vector<int> partition_rows(const SparseProblem& problem, int parts, bool by_nonzeros) {
+	vector<int> boundaries(parts + 1);
+	if (!by_nonzeros) {
+		for (int i = 0; i <= parts; i++) {
+			boundaries[i] = (i == parts) ? problem.size : block_range(problem.size, parts, i).start;
+		}
+		return boundaries;
+	}
+
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	BlockRange share = block_range(problem.size, parts, rank);
+	vector<long long> lengths(share.count);
+	long long local_total = 0;
+	for (int i = 0; i < share.count; i++) {
+		lengths[i] = row_length(problem, share.start + i);
+		local_total += lengths[i];
+	}
+
+	long long before = 0;
+	long long total;
+	MPI_Exscan(&local_total, &before, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(&local_total, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	if (rank == 0) before = 0;
+
+	// boundary i is the first row with at least i * total / parts nonzeros before it
+	vector<int> candidates(parts + 1, problem.size);
+	long long running = before;
+	int row = 0;
+	for (int i = 1; i < parts; i++) {
+		long long target = total * i / parts;
+		while (row < share.count && running < target) {
+			running += lengths[row];
+			row++;
+		}
+		if (running >= target && row < share.count) {
+			candidates[i] = share.start + row;
+		}
+	}
+	candidates[0] = 0;
+
+	MPI_Allreduce(candidates.data(), boundaries.data(), parts + 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+	return boundaries;
+}
+
+/**
+* Generates a block of rows. Most columns are near the diagonal, a few are anywhere.
+*/
+CsrMatrix generate_rows(const SparseProblem& problem, BlockRange rows) {
+	vector<vector<int>> columns(rows.count);
+	ThreadPool::instance().parallel_for(0, rows.count, [&](long long first, long long last) {
+		for (long long i = first; i < last; i++) {
+			int row = rows.start + (int)i;
+			int length = row_length(problem, row);
+			vector<int>& row_columns = columns[i];
+			row_columns.resize(length);
+
+			for (int j = 0; j < length; j++) {
+				uint64_t key = ((uint64_t)row << 32) | (uint64_t)j;
+				double where = RandomTools::uniform_at(problem.seed, STREAM_COLUMNS, key);
+				if (RandomTools::uniform_at(problem.seed, STREAM_FAR, key) < problem.far_fraction) {
+					row_columns[j] = (int)(where * problem.size);
+				}
+				else {
+					int offset = (int)((2 * where - 1) * problem.bandwidth);
+					row_columns[j] = std::clamp(row + offset, 0, problem.size - 1);
+				}
+			}
+
+			std::sort(row_columns.begin(), row_columns.end());
+			row_columns.erase(std::unique(row_columns.begin(), row_columns.end()), row_columns.end());
+		}
+	});
+
+	CsrMatrix matrix;
+	matrix.rows = rows.count;
+	matrix.row_offsets.resize(rows.count + 1);
+	for (int i = 0; i < rows.count; i++) {
+		matrix.row_offsets[i + 1] = matrix.row_offsets[i] + columns[i].size();
+	}
+	matrix.column_indices.resize(matrix.row_offsets[rows.count]);
+	matrix.values.resize(matrix.row_offsets[rows.count]);
+
+	ThreadPool::instance().parallel_for(0, rows.count, [&](long long first, long long last) {
+		for (long long i = first; i < last; i++) {
+			uint64_t row = (uint64_t)(rows.start + i);
+			size_t offset = matrix.row_offsets[i];
+			for (size_t j = 0; j < columns[i].size(); j++) {
+				matrix.column_indices[offset + j] = columns[i][j];
+				matrix.values[offset + j] = 2 * RandomTools::uniform_at(problem.seed, STREAM_VALUES, (row << 32) | j) - 1;
+			}
+		}
+	});
+
+	return matrix;
+}
+
+/**
+* Works out which remote entries of x the rows use, asks their owners for them, and renumbers
+* the columns of the matrix to local indices: owned entries first, then the received ones.
+* Only the entries actually used are ever sent, and only between ranks that share some.
+*/
+Halo build_halo(CsrMatrix& matrix, const vector<int>& boundaries, int rank) {
+	int world_size = (int)boundaries.size() - 1;
+	int first_owned = boundaries[rank];
+	int owned = boundaries[rank + 1] - first_owned;
+
+	vector<int> remote;
+	for (int column : matrix.column_indices) {
+		if (column < first_owned || column >= first_owned + owned) remote.push_back(column);
+	}
+	std::sort(remote.begin(), remote.end());
+	remote.erase(std::unique(remote.begin(), remote.end()), remote.end());
+
+	// sorted columns come grouped by owner already
+	vector<int> wanted(world_size, 0);
+	for (int column : remote) {
+		int owner = (int)(std::upper_bound(boundaries.begin(), boundaries.end(), column) - boundaries.begin()) - 1;
+		wanted[owner]++;
+	}
+
+	vector<int> asked(world_size);
+	MPI_Alltoall(wanted.data(), 1, MPI_INT, asked.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+	vector<int> wanted_displs(world_size, 0);
+	vector<int> asked_displs(world_size, 0);
+	for (int i = 1; i < world_size; i++) {
+		wanted_displs[i] = wanted_displs[i - 1] + wanted[i - 1];
+		asked_displs[i] = asked_displs[i - 1] + asked[i - 1];
+	}
+
+	Halo halo;
+	halo.send_indices.resize(asked_displs[world_size - 1] + asked[world_size - 1]);
+	MPI_Alltoallv(remote.data(), wanted.data(), wanted_displs.data(), MPI_INT,
+		halo.send_indices.data(), asked.data(), asked_displs.data(), MPI_INT, MPI_COMM_WORLD);
+
+	for (int& index : halo.send_indices) index -= first_owned;
+	for (int i = 0; i < world_size; i++) {
+		if (wanted[i] > 0) {
+			halo.receive_ranks.push_back(i);
+			halo.receive_counts.push_back(wanted[i]);
+		}
+		if (asked[i] > 0) {
+			halo.send_ranks.push_back(i);
+			halo.send_counts.push_back(asked[i]);
+		}
+	}
+
+	for (int& column : matrix.column_indices) {
+		if (column >= first_owned && column < first_owned + owned) {
+			column -= first_owned;
+		}
+		else {
+			column = owned + (int)(std::lower_bound(remote.begin(), remote.end(), column) - remote.begin());
+		}
+	}
+
+	return halo;
+}
+
+/**
+* Fills in the halo part of x, width values per entry, by swapping entries with the neighbouring ranks only.
+*/
+void exchange_halo(const Halo& halo, double* x, int owned_rows, int width, vector<double>& send_buffer) {
+	send_buffer.resize(halo.send_indices.size() * width);
+	for (size_t i = 0; i < halo.send_indices.size(); i++) {
+		std::copy(x + (size_t)halo.send_indices[i] * width, x + (size_t)(halo.send_indices[i] + 1) * width, send_buffer.begin() + i * width);
+	}
+
+	vector<MPI_Request> requests;
+	requests.reserve(halo.receive_ranks.size() + halo.send_ranks.size());
+
+	double* receive = x + (size_t)owned_rows * width;
+	for (size_t i = 0; i < halo.receive_ranks.size(); i++) {
+		requests.emplace_back();
+		MPI_Irecv(receive, halo.receive_counts[i] * width, MPI_DOUBLE, halo.receive_ranks[i], 0, MPI_COMM_WORLD, &requests.back());
+		receive += (size_t)halo.receive_counts[i] * width;
+	}
+
+	const double* send = send_buffer.data();
+	for (size_t i = 0; i < halo.send_ranks.size(); i++) {
+		requests.emplace_back();
+		MPI_Isend(send, halo.send_counts[i] * width, MPI_DOUBLE, halo.send_ranks[i], 0, MPI_COMM_WORLD, &requests.back());
+		send += (size_t)halo.send_counts[i] * width;
+	}
+
+	MPI_Waitall((int)requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+/**
+* Multiplies the matrix with width vectors (SpMV for 1, SpMM otherwise) iterations times, exchanging the halo every time.
+*/
+KernelStats run_kernel(const SparseProblem& problem, const CsrMatrix& matrix, const Halo& halo, BlockRange rows, int width, int iterations) {
+	KernelStats stats;
+
+	// x holds the owned entries and then the halo, y only the owned ones
+	vector<double> x((size_t)(rows.count + halo.size()) * width);
+	vector<double> y((size_t)rows.count * width);
+	vector<double> send_buffer;
+	for (int i = 0; i < rows.count; i++) {
+		for (int v = 0; v < width; v++) {
+			x[(size_t)i * width + v] = RandomTools::uniform_at(problem.seed, STREAM_X + v, rows.start + i);
+		}
+	}
+
+	for (int iteration = 0; iteration < iterations; iteration++) {
+		Timer exchange_timer;
+		exchange_halo(halo, x.data(), rows.count, width, send_buffer);
+		stats.exchange_time += exchange_timer.stop().count();
+
+		Timer compute_timer;
+		if (width == 1) {
+			Csr::spmv(matrix, x.data(), y.data());
+		}
+		else {
+			Csr::spmm(matrix, x.data(), y.data(), width);
+		}
+		stats.compute_time += compute_timer.stop().count();
+	}
+
+	for (double value : y) stats.checksum += value;
+	return stats;
+}
@@ -1,7 +1,12 @@
 ﻿#pragma once
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <string>
 #include <vector>
 
 // 3878 is my r0ll numb3r. 3 at the end of it makes it prime. ¯\_(ツ)_/¯
@@ -10,6 +15,7 @@ constexpr int RANDOM_SEED_MULTIPLIER = 3878'3;
 
 /**
 * Wrapper class for command line arguments.
+* Arguments starting with "--" are options (--name or --name=value), the rest are positional.
 */
 class Arguments {
 public:
@@ -20,13 +26,24 @@ public:
 		m_argv = argv;
 		if (argc <= 1) {
 			m_argc = 1;
-			m_argument_index = 1;
-			m_no_of_arguments = 0;
 		}
 		else {
 			m_argc = argc;
-			m_argument_index = 2;
-			m_no_of_arguments = argc - 2;
+			for (int i = 2; i < argc; i++) {
+				std::string argument = argv[i];
+				if (argument.rfind("--", 0) == 0) {
+					size_t equals = argument.find('=');
+					if (equals == std::string::npos) {
+						m_options[argument.substr(2)] = "";
+					}
+					else {
+						m_options[argument.substr(2, equals - 2)] = argument.substr(equals + 1);
+					}
+				}
+				else {
+					m_positional.push_back(i);
+				}
+			}
 		}
 	}
 
@@ -42,10 +59,10 @@ public:
 	}
 
 	/**
-	* @return The number of arguments passed to the program.
+	* @return The number of positional arguments passed to the program.
 	*/
 	int len() {
-		return m_no_of_arguments;
+		return (int)m_positional.size();
 	}
 
 	/**
@@ -53,7 +70,7 @@ public:
 	* @return Whether there is an argument at the given index.
 	*/
 	bool has(int index) {
-		return index < m_no_of_arguments;
+		return index < len();
 	}
 
 	/**
@@ -61,13 +78,47 @@ public:
 	* @return The argument at the given index.
 	*/
 	char* get(int index) {
-         		return m_argv[index + m_argument_index];
+		return m_argv[m_positional[index]];
+	}
+
+	/**
+	* @param name The name of the option, without the leading dashes.
+	* @return Whether the option was passed, with or without a value.
+	*/
+	bool has_option(const std::string& name) {
+		return m_options.count(name) > 0;
+	}
+
+	/**
+	* @param name The name of the option, without the leading dashes.
+	* @param fallback Returned if the option was not passed.
+	* @return The value of the option.
+	*/
+	std::string option(const std::string& name, const std::string& fallback = "") {
+		auto it = m_options.find(name);
+		return (it == m_options.end()) ? fallback : it->second;
+	}
+
+	/**
+	* Same as option(), parsed as an integer.
+	*/
+	long long option_int(const std::string& name, long long fallback) {
+		auto it = m_options.find(name);
+		return (it == m_options.end() || it->second.empty()) ? fallback : std::stoll(it->second);
+	}
+
+	/**
+	* Same as option(), parsed as a floating point number.
+	*/
+	double option_double(const std::string& name, double fallback) {
+		auto it = m_options.find(name);
+		return (it == m_options.end() || it->second.empty()) ? fallback : std::stod(it->second);
 	}
 private:
 	int m_argc;
 	char** m_argv;
-	int m_argument_index;
-	int m_no_of_arguments;
+	std::vector<int> m_positional;
+	std::map<std::string, std::string> m_options;
 };
 
 
@@ -115,6 +166,63 @@ private:
 	std::chrono::duration<double> m_duration;
 };
 
+/**
+* A contiguous share of [0, total) handed to one of several owners.
+*/
+struct BlockRange {
+	int start;
+	int count;
+
+	int end() const { return start + count; }
+};
+
+/**
+* Splits [0, total) into parts nearly equal ranges. The first total % parts ranges get one extra element.
+* @return The range belonging to the given index.
+*/
+inline BlockRange block_range(int total, int parts, int index) {
+	int base = total / parts;
+	int extra = total % parts;
+	return { index * base + std::min(index, extra), base + ((index < extra) ? 1 : 0) };
+}
+
+/**
+* @return The index of the block_range that contains position.
+*/
+inline int block_owner(int total, int parts, int position) {
+	int base = total / parts;
+	int extra = total % parts;
+	int boundary = extra * (base + 1);
+	if (position < boundary) return position / (base + 1);
+	return extra + (position - boundary) / base;
+}
+
+namespace RandomTools {
+	/**
+	* splitmix64's finalizer. Nearby inputs give unrelated outputs.
+	*/
+	inline uint64_t mix(uint64_t x) {
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	/**
+	* A position-addressable random stream. The same (seed, stream, index) always gives the same number,
+	* so any rank can generate any element without generating the ones before it.
+	* @return A uniformly distributed number in [0, 1).
+	*/
+	template <typename T = double> T uniform_at(uint64_t seed, uint64_t stream, uint64_t index) {
+		uint64_t bits = mix(mix(seed + stream * 0x9E3779B97F4A7C15ull) ^ index);
+		if constexpr (sizeof(T) == sizeof(float)) {
+			return (T)(bits >> 40) * 0x1.0p-24f;
+		}
+		else {
+			return (T)(bits >> 11) * 0x1.0p-53;
+		}
+	}
+}
+
 namespace DebugTools {
 	inline void ping() {
 		std::cout << "Pong!" << std::endl;
@@ -187,37 +295,44 @@ namespace MatrixTools {
 		}
 	}
 
-	template <typename T, size_t X, size_t Y> void peek_at_matrix_vec_flattened(vector<T> matrix, int peek_size) {
-		std::cout << std::fixed << std::setprecision(2);
-		if (peek_size > X || peek_size > Y) {
+	/**
+	* Like the others, but the elements come from element(row, column), so the matrix never has to exist in one place.
+	*/
+	template <typename F> void peek_at_matrix_fn(F element, size_t rows, size_t columns, size_t peek_size) {
+		if (peek_size > rows || peek_size > columns) {
 			std::cerr << "Error: peek_size is too large for matrix dimensions!" << std::endl;
 			return;
 		}
+		std::cout << std::fixed << std::setprecision(2);
 
-		for (int i = 0; i < peek_size; i++) {
-			for (int j = 0; j < peek_size; j++) {
-				std::cout << matrix[i * Y + j] << "\t";
+		for (size_t i = 0; i < peek_size; i++) {
+			for (size_t j = 0; j < peek_size; j++) {
+				std::cout << element(i, j) << "\t";
 			}
 			std::cout << "....\t";
 
-			for (int j = Y - peek_size; j < Y; j++) {
-				std::cout << matrix[i * Y + j] << "\t";
+			for (size_t j = columns - peek_size; j < columns; j++) {
+				std::cout << element(i, j) << "\t";
 			}
 			std::cout << std::endl;
 		}
 
 		std::cout << ".\n.\n.\n.\n";
 
-		for (int i = X - peek_size; i < X; i++) {
-			for (int j = 0; j < peek_size; j++) {
-				std::cout << matrix[i * Y + j] << "\t";
+		for (size_t i = rows - peek_size; i < rows; i++) {
+			for (size_t j = 0; j < peek_size; j++) {
+				std::cout << element(i, j) << "\t";
 			}
 			std::cout << "....\t";
-			for (int j = Y - peek_size; j < Y; j++) {
-				std::cout << matrix[i * Y + j] << "\t";
+			for (size_t j = columns - peek_size; j < columns; j++) {
+				std::cout << element(i, j) << "\t";
 			}
 			std::cout << std::endl;
 		}
 		std::cout << std::defaultfloat << std::setprecision(6);
 	}
+
+	template <typename T> void peek_at_matrix_vec_flattened(const vector<T>& matrix, size_t rows, size_t columns, size_t peek_size) {
+		peek_at_matrix_fn([&](size_t i, size_t j) { return matrix[i * columns + j]; }, rows, columns, peek_size);
+	}
 }
\ No newline at end of file
@@ -2,9 +2,15 @@
 
 #include <iostream>
 #include <mpi.h>
+#include <string>
+#include <thread>
+
+void configure_thread_pool(Arguments& args, int provided, bool is_main_thread);
 
 int main(int argc, char* argv[]) {
-	MPI_Init(&argc, &argv);
+	// only the thread that called this makes MPI calls, the thread pool's workers never do
+	int provided;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 	Arguments args(argc, argv);
 
 	int rc = 0;
@@ -14,6 +20,8 @@ int main(int argc, char* argv[]) {
 
 	bool is_main_thread = rank == 0;
 
+	configure_thread_pool(args, provided, is_main_thread);
+
 	Program program = Program::None;
 
 	if (is_main_thread) {
@@ -51,6 +59,10 @@ int main(int argc, char* argv[]) {
 		if (is_main_thread) std::cout << "Running Heat Simulation:" << std::endl;
 		rc = heat_sim(args);
 		break;
+	case Program::Sparse_Multiplication:
+		if (is_main_thread) std::cout << "Running Sparse Matrix Multiplication:" << std::endl;
+		rc = spmm(args);
+		break;
 	default:
 		if (is_main_thread) std::cout << "Invalid program selected." << std::endl;
 		break;
@@ -60,4 +72,34 @@ int main(int argc, char* argv[]) {
 	MPI_Finalize();
 	
 	return rc;
-}
\ No newline at end of file
+}
+
+/**
+* Sets up the shared thread pool from --threads=<n|auto> and --no-pin.
+* "auto" splits the cores of a node evenly between the ranks running on it,
+* so the hybrid setup is one rank per node (or socket) with --threads=auto.
+*/
+void configure_thread_pool(Arguments& args, int provided, bool is_main_thread) {
+	MPI_Comm node;
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+	int node_rank;
+	MPI_Comm_rank(node, &node_rank);
+	int ranks_on_node;
+	MPI_Comm_size(node, &ranks_on_node);
+	MPI_Comm_free(&node);
+
+	int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+	std::string requested = args.option("threads", "1");
+	int threads = (requested == "auto") ? std::max(1, cores / ranks_on_node) : std::max(1, std::stoi(requested));
+
+	if (threads > 1 && provided < MPI_THREAD_FUNNELED) {
+		if (is_main_thread) std::cerr << "Warning: MPI does not support MPI_THREAD_FUNNELED, threads may misbehave." << std::endl;
+	}
+
+	bool pin = threads > 1 && !args.has_option("no-pin");
+	ThreadPool::instance().configure(threads, pin, node_rank * threads);
+
+	if (is_main_thread && threads > 1) {
+		std::cout << "Using " << threads << " threads per rank" << (pin ? ", pinned to cores." : ".") << std::endl;
+	}
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "helpers.h"
+#include "thread_pool.h"
 #include <map>
 #include <string>
 
@@ -8,7 +9,8 @@ enum class Program {
 
 	Monte_Carlo,
 	Matrix_Multiplication,
-	Heat_Sim
+	Heat_Sim,
+	Sparse_Multiplication
 };
 
 const std::map<std::string, Program> PROGRAM_NAMES = {
@@ -16,9 +18,11 @@ const std::map<std::string, Program> PROGRAM_NAMES = {
 	std::make_pair("monte_carlo", Program::Monte_Carlo),
 	std::make_pair("matrix_m", Program::Matrix_Multiplication),
 	std::make_pair("heat_sim", Program::Heat_Sim),
+	std::make_pair("spmm", Program::Sparse_Multiplication),
 };
 
 // programs
 int monte_carlo(Arguments args);
 int matrix_multiplication(Arguments args);
-int heat_sim(Arguments args);
\ No newline at end of file
+int heat_sim(Arguments args);
+int spmm(Arguments args);
\ No newline at end of file
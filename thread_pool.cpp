@@ -0,0 +1,156 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static thread_local int current_thread_index = 0;
+
+static void pin_to_core(int core) {
+	int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+	core %= cores;
+
+#ifdef _WIN32
+	if (core < 64) SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+ThreadPool& ThreadPool::instance() {
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::ThreadPool() {
+	m_queues.push_back(std::make_unique<Queue>());
+}
+
+ThreadPool::~ThreadPool() {
+	stop();
+}
+
+void ThreadPool::configure(int threads, bool pin, int first_core) {
+	stop();
+
+	threads = std::max(1, threads);
+	m_queues.clear();
+	for (int i = 0; i < threads; i++) {
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+
+	if (pin) pin_to_core(first_core);
+
+	m_stopping = false;
+	for (int i = 1; i < threads; i++) {
+		m_threads.emplace_back([this, i, pin, first_core]() {
+			current_thread_index = i;
+			if (pin) pin_to_core(first_core + i);
+			work(i);
+		});
+	}
+}
+
+int ThreadPool::thread_index() {
+	return current_thread_index;
+}
+
+void ThreadPool::run(int tasks, const std::function<void(int)>& task) {
+	if (tasks <= 0) return;
+
+	// nested calls and single threaded pools just run inline
+	if (size() == 1 || tasks == 1 || current_thread_index != 0 || m_remaining > 0) {
+		for (int i = 0; i < tasks; i++) task(i);
+		return;
+	}
+
+	m_task = &task;
+	m_remaining = tasks;
+
+	int threads = size();
+	for (int i = 0; i < threads; i++) {
+		std::lock_guard<std::mutex> lock(m_queues[i]->mutex);
+		for (int t = (int)((long long)tasks * i / threads); t < (int)((long long)tasks * (i + 1) / threads); t++) {
+			m_queues[i]->tasks.push_back(t);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	while (m_remaining > 0) {
+		if (!try_run_one(0)) std::this_thread::yield();
+	}
+}
+
+void ThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+	m_threads.clear();
+}
+
+void ThreadPool::work(int index) {
+	long long seen_generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_stopping || m_generation != seen_generation; });
+			if (m_stopping) return;
+			seen_generation = m_generation;
+		}
+
+		while (try_run_one(index));
+	}
+}
+
+/**
+* Runs a task from this thread's own queue, or steals one from the back of someone else's.
+* @return Whether a task was found.
+*/
+bool ThreadPool::try_run_one(int index) {
+	int threads = size();
+
+	for (int offset = 0; offset < threads; offset++) {
+		Queue& queue = *m_queues[(index + offset) % threads];
+		int task;
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty()) continue;
+
+			if (offset == 0) {
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			else {
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+		}
+
+		(*m_task)(task);
+		m_remaining--;
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* Work-stealing thread pool shared by every program, for parallel loops inside a rank.
+* The thread calling run() works through its own queue too, so a pool of size 1 has no
+* extra threads at all and runs everything inline.
+* Only the thread that called MPI_Init_thread should call run() (MPI_THREAD_FUNNELED).
+*/
+class ThreadPool {
+public:
+	static ThreadPool& instance();
+
+	~ThreadPool();
+
+	/**
+	* (Re)starts the pool with the given number of threads, including the calling one.
+	* @param pin Whether to pin thread i to core first_core + i.
+	*/
+	void configure(int threads, bool pin, int first_core);
+
+	/**
+	* @return The number of threads work is split between, including the calling one.
+	*/
+	int size() const {
+		return (int)m_queues.size();
+	}
+
+	/**
+	* @return The index of the current thread in the pool, 0 for the thread calling run().
+	*/
+	static int thread_index();
+
+	/**
+	* Calls task(0) ... task(tasks - 1) across the pool and returns once all of them have finished.
+	* Each thread starts on a contiguous share of the tasks and steals from the others once it runs out.
+	*/
+	void run(int tasks, const std::function<void(int)>& task);
+
+	/**
+	* Splits [begin, end) into chunks and calls body(chunk_begin, chunk_end) for each of them across the pool.
+	*/
+	template <typename F> void parallel_for(long long begin, long long end, F body) {
+		long long count = end - begin;
+		if (count <= 0) return;
+
+		int chunks = (int)std::min<long long>(count, (long long)size() * CHUNKS_PER_THREAD);
+		run(chunks, [&](int chunk) {
+			body(begin + count * chunk / chunks, begin + count * (chunk + 1) / chunks);
+		});
+	}
+
+private:
+	// more chunks than threads, so there is something left to steal when a thread falls behind
+	static constexpr int CHUNKS_PER_THREAD = 4;
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<int> tasks;
+	};
+
+	ThreadPool();
+	void stop();
+	void work(int index);
+	bool try_run_one(int index);
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	const std::function<void(int)>* m_task = nullptr;
+	std::atomic<int> m_remaining = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	long long m_generation = 0;
+	bool m_stopping = false;
+};